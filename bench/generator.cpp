@@ -0,0 +1,136 @@
+#include "generator.hpp"
+#include <cmath>
+#include <random>
+#include <string>
+
+using namespace libbndl;
+
+namespace
+{
+	// std::mt19937_64's output is fixed by the standard, unlike the distributions, so do the mapping here.
+	class Random
+	{
+	public:
+		explicit Random(uint64_t seed) : m_engine(seed) {}
+
+		uint64_t Next()
+		{
+			return m_engine();
+		}
+
+		uint32_t Below(uint32_t bound)
+		{
+			return bound == 0 ? 0 : static_cast<uint32_t>(Next() % bound);
+		}
+
+		double Unit()
+		{
+			return (Next() >> 11) * (1.0 / 9007199254740992.0);
+		}
+
+	private:
+		std::mt19937_64 m_engine;
+	};
+
+	constexpr Bundle::ResourceType ResourceTypes[] = {
+		Bundle::Raster, Bundle::Material, Bundle::TextFile, Bundle::Renderable, Bundle::Model,
+		Bundle::Shader, Bundle::AttribSysVault, Bundle::VideoData, Bundle::GinsuWaveContent
+	};
+
+	uint32_t BlockSize(Random &random, const GeneratorOptions &options)
+	{
+		const auto low = std::log(static_cast<double>(std::max(options.minBlockSize, 1U)));
+		const auto high = std::log(static_cast<double>(std::max(options.maxBlockSize, options.minBlockSize)));
+		return static_cast<uint32_t>(std::exp(low + (high - low) * random.Unit()));
+	}
+
+	// Mixes random runs with repeated ones so the data compresses about as well as asked for.
+	std::unique_ptr<std::vector<uint8_t>> BlockData(Random &random, uint32_t size, uint32_t randomPercent)
+	{
+		auto data = std::make_unique<std::vector<uint8_t>>(size);
+		for (uint32_t offset = 0; offset < size; offset += 64)
+		{
+			const auto end = std::min(offset + 64, size);
+			if (random.Below(100) < randomPercent)
+			{
+				for (auto i = offset; i < end; i++)
+					(*data)[i] = static_cast<uint8_t>(random.Next());
+			}
+			else
+			{
+				const auto value = static_cast<uint8_t>(random.Below(4));
+				std::fill(data->begin() + offset, data->begin() + end, value);
+			}
+		}
+
+		return data;
+	}
+}
+
+std::vector<GeneratedResource> GenerateResources(const GeneratorOptions &options)
+{
+	Random random(options.seed);
+
+	std::vector<GeneratedResource> resources;
+	resources.reserve(options.entryCount);
+
+	uint32_t resourceID = 0;
+	for (auto i = 0U; i < options.entryCount; i++)
+	{
+		GeneratedResource resource;
+		resourceID += 1 + random.Below(0x10000); // Increasing, so IDs never repeat.
+		resource.resourceID = resourceID;
+		resource.resourceType = ResourceTypes[random.Below(std::size(ResourceTypes))];
+
+		auto &data = resource.data;
+		data.fileBlockData[0] = BlockData(random, BlockSize(random, options), options.randomPercent);
+		data.alignments[0] = 16;
+		data.alignments[1] = options.magicVersion == Bundle::BND2 ? 128 : 16;
+		data.alignments[2] = 16;
+		if (random.Below(100) < options.secondaryBlockPercent)
+			data.fileBlockData[1] = BlockData(random, BlockSize(random, options), options.randomPercent);
+
+		for (auto j = 0U; j < options.dependencies && i > 0; j++)
+		{
+			const auto &target = resources[random.Below(i)];
+			const auto internalOffset = random.Below(static_cast<uint32_t>(data.fileBlockData[0]->size())) & ~3U;
+			data.dependencies.push_back({ target.resourceID, internalOffset });
+		}
+
+		resources.push_back(std::move(resource));
+	}
+
+	return resources;
+}
+
+Bundle CreateBundle(const GeneratorOptions &options)
+{
+	auto flags = Bundle::UnusedFlag1 | Bundle::UnusedFlag2;
+	if (options.compressed)
+		flags |= Bundle::Compressed;
+	if (options.rstEntries > 0)
+		flags |= Bundle::HasResourceStringTable;
+
+	const auto platform = options.magicVersion == Bundle::BNDL ? Bundle::Xbox360 : options.platform;
+	return Bundle(options.magicVersion, options.magicVersion == Bundle::BND2 ? 2 : 5, platform, static_cast<Bundle::Flags>(flags));
+}
+
+bool AddResources(Bundle &bundle, const std::vector<GeneratedResource> &resources, const GeneratorOptions &options)
+{
+	for (const auto &resource : resources)
+	{
+		if (!bundle.AddResource(resource.resourceID, resource.data, resource.resourceType))
+			return false;
+	}
+
+	const auto rstEntries = std::min<size_t>(options.rstEntries, resources.size());
+	for (auto i = 0U; i < rstEntries; i++)
+	{
+		const auto &resource = resources[i];
+		const auto name = "gamedb://burnout5/Generated/Resource_" + std::to_string(resource.resourceID) + "?ID=" + std::to_string(resource.resourceID);
+		if (!bundle.AddDebugInfo(resource.resourceID, name, "Generated"))
+			return false;
+	}
+
+	return true;
+}
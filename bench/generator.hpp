@@ -0,0 +1,31 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <cstdint>
+#include <vector>
+
+// Describes a synthetic bundle. The same options and seed always produce the same bundle.
+struct GeneratorOptions
+{
+	libbndl::Bundle::MagicVersion magicVersion = libbndl::Bundle::BND2;
+	libbndl::Bundle::Platform platform = libbndl::Bundle::PC;
+	bool compressed = true;
+	uint32_t entryCount = 1000;
+	uint32_t minBlockSize = 256; // Block sizes are spread log-uniformly between these.
+	uint32_t maxBlockSize = 256 * 1024;
+	uint32_t secondaryBlockPercent = 25; // Chance of an entry also having a block 1.
+	uint32_t randomPercent = 50; // Share of incompressible bytes.
+	uint32_t dependencies = 2; // Per entry, pointing at earlier entries.
+	uint32_t rstEntries = 0; // How many entries get debug info.
+	uint64_t seed = 1;
+};
+
+struct GeneratedResource
+{
+	uint32_t resourceID;
+	libbndl::Bundle::ResourceType resourceType;
+	libbndl::Bundle::EntryData data;
+};
+
+std::vector<GeneratedResource> GenerateResources(const GeneratorOptions &options);
+libbndl::Bundle CreateBundle(const GeneratorOptions &options);
+bool AddResources(libbndl::Bundle &bundle, const std::vector<GeneratedResource> &resources, const GeneratorOptions &options);
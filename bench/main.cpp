@@ -0,0 +1,190 @@
+#include "generator.hpp"
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <cxxopts.hpp>
+
+using namespace libbndl;
+
+namespace
+{
+	template <typename T>
+	T OptionOr(const cxxopts::Options &options, const std::string &name, T fallback)
+	{
+		return options.count(name) ? options[name].as<T>() : fallback;
+	}
+
+	struct Result
+	{
+		std::string operation;
+		double bestSeconds;
+		double medianSeconds;
+	};
+
+	// Runs the operation a few times and keeps the best and median wall time.
+	bool Measure(const std::string &operation, uint32_t iterations, const std::function<bool()> &run, std::vector<Result> &results)
+	{
+		std::vector<double> seconds;
+		for (auto i = 0U; i < iterations; i++)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			if (!run())
+			{
+				std::cout << operation << " failed" << std::endl;
+				return false;
+			}
+			seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+
+		std::sort(seconds.begin(), seconds.end());
+		results.push_back({ operation, seconds.front(), seconds[seconds.size() / 2] });
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	cxxopts::Options options("libbndl_bench", "Generates synthetic bundles and times libbndl against them.");
+	options.add_options()
+		("format", "bnd2 or bndl", cxxopts::value<std::string>())
+		("platform", "pc, xbox360 or ps3 (BND2 only)", cxxopts::value<std::string>())
+		("uncompressed", "Generate an uncompressed bundle")
+		("entries", "Number of resources", cxxopts::value<uint32_t>())
+		("min-size", "Smallest block size in bytes", cxxopts::value<uint32_t>())
+		("max-size", "Largest block size in bytes", cxxopts::value<uint32_t>())
+		("secondary", "Percentage of resources with a second block", cxxopts::value<uint32_t>())
+		("random", "Percentage of incompressible bytes", cxxopts::value<uint32_t>())
+		("dependencies", "Dependencies per resource", cxxopts::value<uint32_t>())
+		("rst", "Resources with debug info", cxxopts::value<uint32_t>())
+		("seed", "Generator seed", cxxopts::value<uint64_t>())
+		("iterations", "Runs per operation", cxxopts::value<uint32_t>())
+		("o,output", "Write the generated bundle here and skip the benchmarks", cxxopts::value<std::string>())
+		("h,help", "Show the options");
+
+	options.parse(argc, argv);
+	if (options.count("help"))
+	{
+		std::cout << options.help() << std::endl;
+		return 0;
+	}
+
+	GeneratorOptions generator;
+	const auto format = OptionOr<std::string>(options, "format", "bnd2");
+	if (format == "bndl")
+		generator.magicVersion = Bundle::BNDL;
+	else if (format != "bnd2")
+	{
+		std::cout << "Unknown format " << format << std::endl << options.help() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const auto platform = OptionOr<std::string>(options, "platform", "pc");
+	if (platform == "xbox360")
+		generator.platform = Bundle::Xbox360;
+	else if (platform == "ps3")
+		generator.platform = Bundle::PS3;
+	else if (platform != "pc")
+	{
+		std::cout << "Unknown platform " << platform << std::endl << options.help() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	generator.compressed = !options["uncompressed"].as<bool>();
+	generator.entryCount = OptionOr(options, "entries", generator.entryCount);
+	generator.minBlockSize = OptionOr(options, "min-size", generator.minBlockSize);
+	generator.maxBlockSize = OptionOr(options, "max-size", generator.maxBlockSize);
+	generator.secondaryBlockPercent = OptionOr(options, "secondary", generator.secondaryBlockPercent);
+	generator.randomPercent = OptionOr(options, "random", generator.randomPercent);
+	generator.dependencies = OptionOr(options, "dependencies", generator.dependencies);
+	generator.rstEntries = OptionOr(options, "rst", generator.rstEntries);
+	generator.seed = OptionOr(options, "seed", generator.seed);
+	const auto iterations = std::max(OptionOr(options, "iterations", 5U), 1U);
+
+	const auto resources = GenerateResources(generator);
+
+	if (options.count("output"))
+	{
+		auto bundle = CreateBundle(generator);
+		if (!AddResources(bundle, resources, generator) || !bundle.Save(options["output"].as<std::string>()))
+		{
+			std::cout << "Failed to write " << options["output"].as<std::string>() << std::endl;
+			return EXIT_FAILURE;
+		}
+		return 0;
+	}
+
+	uint64_t totalBytes = 0;
+	for (const auto &resource : resources)
+	{
+		for (const auto &block : resource.data.fileBlockData)
+		{
+			if (block)
+				totalBytes += block->size();
+		}
+	}
+
+	const auto file = (std::filesystem::temp_directory_path() / ("libbndl_bench_" + std::to_string(generator.seed) + "." + format)).string();
+	std::vector<Result> results;
+
+	// Each operation works on the output of the one before it.
+	auto source = CreateBundle(generator);
+	auto ok = Measure("add", iterations, [&]
+	{
+		source = CreateBundle(generator);
+		return AddResources(source, resources, generator);
+	}, results);
+
+	ok = ok && Measure("save", iterations, [&] { return source.Save(file); }, results);
+
+	Bundle loaded;
+	ok = ok && Measure("load", iterations, [&] { return loaded.Load(file); }, results);
+
+	ok = ok && Measure("get-binary", iterations, [&]
+	{
+		for (const auto &resource : resources)
+		{
+			for (auto i = 0U; i < 3; i++)
+			{
+				if (resource.data.fileBlockData[i] && loaded.GetBinary(resource.resourceID, i) == nullptr)
+					return false;
+			}
+		}
+		return true;
+	}, results);
+
+	ok = ok && Measure("replace", iterations, [&]
+	{
+		for (const auto &resource : resources)
+		{
+			if (!loaded.ReplaceResource(resource.resourceID, resource.data))
+				return false;
+		}
+		return true;
+	}, results);
+
+	std::error_code error;
+	const auto fileSize = std::filesystem::file_size(file, error);
+	std::filesystem::remove(file, error);
+
+	if (!ok)
+		return EXIT_FAILURE;
+
+	std::cout << resources.size() << " resources, " << totalBytes << " bytes uncompressed, " << fileSize << " bytes on disk" << std::endl;
+	std::cout << std::left << std::setw(12) << "OPERATION" << std::right
+		<< std::setw(12) << "BEST MS" << std::setw(12) << "MEDIAN MS" << std::setw(12) << "MB/S" << std::setw(14) << "ENTRIES/S" << std::endl;
+	std::cout << std::fixed << std::setprecision(2);
+	for (const auto &result : results)
+	{
+		const auto seconds = std::max(result.bestSeconds, 1e-9);
+		std::cout << std::left << std::setw(12) << result.operation << std::right
+			<< std::setw(12) << result.bestSeconds * 1000 << std::setw(12) << result.medianSeconds * 1000
+			<< std::setw(12) << totalBytes / seconds / (1024 * 1024) << std::setw(14) << resources.size() / seconds << std::endl;
+	}
+
+	return 0;
+}
@@ -6,6 +6,8 @@
 #include <mutex>
 #include <memory>
 #include <optional>
+#include <iterator>
+#include <thread>
 
 namespace binaryio
 {
@@ -15,6 +17,10 @@ namespace binaryio
 
 namespace libbndl
 {
+	class StatisticsCollector;
+	class AccessRecorder;
+	class DiskCache;
+
 	class Bundle
 	{
 	public:
@@ -159,41 +165,116 @@ namespace libbndl
 		};
 
 
-		struct EntryFileBlockData
-		{
-			uint32_t uncompressedSize;
-			uint32_t uncompressedAlignment; // default depending on file type
-			uint32_t compressedSize;
-			std::unique_ptr<std::vector<uint8_t>> data;
-		};
-
 		struct EntryDebugInfo
 		{
 			std::string name;
 			std::string typeName;
 		};
 
-		struct EntryInfo
+		struct Dependency
 		{
-			uint32_t checksum; // Stored in bundle as 64-bit (8-byte)
+			uint32_t resourceID;
+			uint32_t internalOffset;
+		};
 
-			uint32_t dependenciesOffset;
-			ResourceType resourceType;
-			uint16_t numberOfDependencies;
+		struct SizeTotals
+		{
+			uint32_t resourceCount;
+			uint64_t uncompressedSize[3];
+			uint64_t compressedSize[3]; // 0 for uncompressed bundles
 		};
 
-		struct Dependency
+
+		struct Statistics
 		{
-			uint32_t resourceID;
-			uint32_t internalOffset;
+			struct Counters
+			{
+				uint64_t bytesRead; // Stored bytes, as they are in the file
+				uint64_t bytesInflated; // Output of inflate
+				uint64_t bytesDeflated; // Input to deflate
+				uint64_t inflateNanoseconds;
+				uint64_t deflateNanoseconds;
+				uint64_t allocations; // Payload buffers only
+				uint64_t allocatedBytes;
+				uint64_t cacheHits;
+				uint64_t cacheMisses;
+			};
+
+			Counters total;
+			std::map<ResourceType, Counters> byType; // Work that can't be tied to one resource only shows up in total.
 		};
 
-		struct Entry
+		// Receives one call per finished phase, possibly from several threads at once. Times are in steady clock nanoseconds.
+		class LIBBNDL_EXPORT TraceSink
 		{
-			EntryInfo info;
-			EntryFileBlockData fileBlockData[3];
+		public:
+			virtual ~TraceSink() = default;
+			virtual void Complete(const char *name, uint64_t startNanoseconds, uint64_t durationNanoseconds, std::optional<uint32_t> resourceID) = 0;
 		};
 
+		// Collects phases and writes them as Chrome trace event JSON, which chrome://tracing and Perfetto can open.
+		class LIBBNDL_EXPORT ChromeTraceSink : public TraceSink
+		{
+		public:
+			explicit ChromeTraceSink(const std::string &path);
+			~ChromeTraceSink() override; // Flushes.
+
+			void Complete(const char *name, uint64_t startNanoseconds, uint64_t durationNanoseconds, std::optional<uint32_t> resourceID) override;
+			// Rewrites the file with everything collected so far.
+			bool Flush();
+
+		private:
+			struct Event
+			{
+				const char *name;
+				uint64_t startNanoseconds;
+				uint64_t durationNanoseconds;
+				uint32_t thread;
+				std::optional<uint32_t> resourceID;
+			};
+
+			std::string m_path;
+			std::mutex m_mutex;
+			std::vector<Event> m_events;
+			std::map<std::thread::id, uint32_t> m_threads;
+		};
+
+		enum StorageMode
+		{
+			SeparateBlocks, // One allocation per loaded block. The default.
+			// Loaded blocks are offsets into the file buffer: one allocation and no copies, but the whole file stays alive
+			// while any block, copy of the bundle or BlockReader still uses it. Payloads keep their file alignment.
+			SharedArena
+		};
+
+		// Estimated heap use by category. Buffers shared with copies of the bundle are counted in each copy.
+		struct MemoryFootprint
+		{
+			uint64_t fileBuffers; // Loaded files that blocks point into
+			uint64_t blockBuffers; // Payloads held by single blocks
+			uint64_t entryTable;
+			uint64_t typeIndex;
+			uint64_t debugInfo;
+			uint64_t dependencies;
+			uint64_t total;
+			std::map<ResourceType, uint64_t> payloadsByType; // Resident stored bytes of each type's blocks
+			uint32_t releasedBlocks; // Left in the file under the memory budget
+		};
+
+		struct SaveOptions
+		{
+			// BND2 only: byte-identical stored blocks are written once and shared through the entries' data offsets.
+			bool deduplicate = false;
+			// BND2 only: data of these resources is written first, in this order, and the rest follows by ID.
+			// Use an access trace or GetDependencyOrder so that reading in that order is sequential.
+			std::vector<uint32_t> layoutOrder;
+		};
+
+		struct SaveReport
+		{
+			uint32_t duplicateBlocks = 0;
+			uint64_t bytesSaved = 0; // Stored bytes not written, before alignment padding
+		};
 
 		struct EntryData
 		{
@@ -202,12 +283,338 @@ namespace libbndl
 			std::vector<Dependency> dependencies;
 		};
 
+		// Blocks already deflated the way a compressed bundle stores them.
+		struct CompressedEntryData
+		{
+			std::unique_ptr<std::vector<uint8_t>> fileBlockData[3];
+			uint32_t uncompressedSizes[3];
+			uint32_t alignments[3];
+			std::vector<Dependency> dependencies; // BND2 expects these to already be in block 0.
+			uint32_t dependenciesOffset; // BND2 only: where the table starts in the uncompressed block 0.
+		};
+
+		// Everything known about an entry without touching its payload.
+		struct EntryView
+		{
+			uint32_t resourceID;
+			ResourceType resourceType;
+			uint32_t uncompressedSize[3];
+			uint32_t uncompressedAlignment[3];
+			uint32_t compressedSize[3];
+			uint16_t numberOfDependencies;
+			const EntryDebugInfo *debugInfo; // nullptr when the bundle has none for this entry
+		};
+
+		class EntryIterator
+		{
+		public:
+			using iterator_category = std::forward_iterator_tag;
+			using value_type = EntryView;
+			using difference_type = std::ptrdiff_t;
+			using reference = EntryView;
+
+			// Views are built on the fly, so -> hands out a temporary that holds one.
+			struct ArrowProxy
+			{
+				EntryView view;
+
+				const EntryView *operator->() const
+				{
+					return &view;
+				}
+			};
+			using pointer = ArrowProxy;
+
+			LIBBNDL_EXPORT EntryView operator*() const;
+
+			LIBBNDL_EXPORT ArrowProxy operator->() const
+			{
+				return { **this };
+			}
+			LIBBNDL_EXPORT EntryIterator &operator++();
+
+			LIBBNDL_EXPORT EntryIterator operator++(int)
+			{
+				auto previous = *this;
+				++*this;
+				return previous;
+			}
+
+			LIBBNDL_EXPORT bool operator==(const EntryIterator &other) const
+			{
+				return m_resourceID == other.m_resourceID;
+			}
+
+			LIBBNDL_EXPORT bool operator!=(const EntryIterator &other) const
+			{
+				return m_resourceID != other.m_resourceID;
+			}
+
+		private:
+			friend class Bundle;
+			EntryIterator(const Bundle *bundle, const uint32_t *resourceID, const uint32_t *end);
+
+			void Sync();
+
+			const Bundle *m_bundle;
+			const uint32_t *m_resourceID; // Walks either the ID column or one list of the type index.
+			const uint32_t *m_end;
+			size_t m_row;
+			std::map<uint32_t, EntryDebugInfo>::const_iterator m_debugInfo;
+		};
+
+		class EntryRange
+		{
+		public:
+			LIBBNDL_EXPORT EntryIterator begin() const
+			{
+				return m_begin;
+			}
+
+			LIBBNDL_EXPORT EntryIterator end() const
+			{
+				return m_end;
+			}
+
+			LIBBNDL_EXPORT size_t size() const
+			{
+				return m_size;
+			}
+
+			LIBBNDL_EXPORT bool empty() const
+			{
+				return m_size == 0;
+			}
+
+		private:
+			friend class Bundle;
+			EntryRange(EntryIterator begin, EntryIterator end, size_t size) : m_begin(begin), m_end(end), m_size(size) {}
+
+			EntryIterator m_begin;
+			EntryIterator m_end;
+			size_t m_size;
+		};
+
+		// Heap memory with a guaranteed alignment. data() is nullptr if the allocation failed.
+		class AlignedBuffer
+		{
+		public:
+			// Huge pages are only used for large enough buffers, and only where the OS supports them.
+			LIBBNDL_EXPORT AlignedBuffer(size_t size, size_t alignment, bool allowHugePages = false);
+			LIBBNDL_EXPORT AlignedBuffer(AlignedBuffer &&other) noexcept;
+			LIBBNDL_EXPORT AlignedBuffer &operator=(AlignedBuffer &&other) noexcept;
+			LIBBNDL_EXPORT ~AlignedBuffer();
+
+			LIBBNDL_EXPORT uint8_t *data()
+			{
+				return m_data;
+			}
+
+			LIBBNDL_EXPORT const uint8_t *data() const
+			{
+				return m_data;
+			}
+
+			LIBBNDL_EXPORT size_t size() const
+			{
+				return m_size;
+			}
+
+			LIBBNDL_EXPORT size_t GetAlignment() const
+			{
+				return m_alignment;
+			}
+
+			LIBBNDL_EXPORT bool IsHugePageBacked() const
+			{
+				return m_mappedSize != 0;
+			}
+
+		private:
+			void Release();
+
+			uint8_t *m_data = nullptr;
+			size_t m_size = 0;
+			size_t m_alignment = 0;
+			size_t m_mappedSize = 0; // Non-zero when the memory came from mmap.
+		};
+
+		// Pulls a block's contents in pieces, only inflating as much as has been asked for.
+		class BlockReader
+		{
+		public:
+			LIBBNDL_EXPORT BlockReader(BlockReader &&other) noexcept;
+			LIBBNDL_EXPORT BlockReader &operator=(BlockReader &&other) noexcept;
+			LIBBNDL_EXPORT ~BlockReader();
+
+			// Returns how much was read, which is only short at the end of the block or on corrupt data.
+			LIBBNDL_EXPORT size_t Read(uint8_t *buffer, size_t size);
+
+			LIBBNDL_EXPORT size_t GetSize() const
+			{
+				return m_size;
+			}
+
+			LIBBNDL_EXPORT size_t GetPosition() const
+			{
+				return m_position;
+			}
+
+			// False once the stored data turned out to be corrupt.
+			LIBBNDL_EXPORT bool IsGood() const
+			{
+				return m_good;
+			}
+
+		private:
+			friend class Bundle;
+			struct Inflater;
+
+			BlockReader(std::shared_ptr<const std::vector<uint8_t>> buffer, const uint8_t *data, size_t storedSize, size_t size, bool compressed,
+				std::shared_ptr<StatisticsCollector> statistics, ResourceType resourceType);
+
+			std::shared_ptr<const std::vector<uint8_t>> m_buffer; // Keeps the stored bytes alive.
+			const uint8_t *m_data;
+			size_t m_storedSize;
+			size_t m_size;
+			size_t m_position = 0;
+			bool m_good = true;
+			std::unique_ptr<Inflater> m_inflater; // nullptr for uncompressed bundles
+			std::shared_ptr<StatisticsCollector> m_statistics;
+			ResourceType m_resourceType;
+		};
+
+		// Stages adds, replaces, removals and debug info, then applies them all at once on Commit.
+		// Nothing is checked or compressed until then. The bundle must outlive the edit.
+		class Edit
+		{
+		public:
+			LIBBNDL_EXPORT Edit(Edit &&other) noexcept = default;
+			LIBBNDL_EXPORT Edit &operator=(Edit &&other) noexcept = default;
+
+			LIBBNDL_EXPORT void AddResource(const std::string &resourceName, EntryData &&data, ResourceType resourceType);
+			LIBBNDL_EXPORT void AddResource(uint32_t resourceID, EntryData &&data, ResourceType resourceType);
+			LIBBNDL_EXPORT void ReplaceResource(const std::string &resourceName, EntryData &&data);
+			LIBBNDL_EXPORT void ReplaceResource(uint32_t resourceID, EntryData &&data);
+			LIBBNDL_EXPORT void RemoveResource(const std::string &resourceName);
+			LIBBNDL_EXPORT void RemoveResource(uint32_t resourceID);
+			LIBBNDL_EXPORT void AddDebugInfo(const std::string &resourceName, const std::string &name, const std::string &type);
+			LIBBNDL_EXPORT void AddDebugInfo(uint32_t resourceID, const std::string &name, const std::string &type);
+
+			// Checks the operations in order with the same rules as the single calls, compresses on up to
+			// threads threads (0 for one per core), then updates the bundle in one pass. If anything fails,
+			// the bundle is left as it was. Either way the staged operations are used up.
+			LIBBNDL_EXPORT bool Commit(unsigned threads = 0);
+
+			LIBBNDL_EXPORT size_t GetOperationCount() const
+			{
+				return m_operations.size();
+			}
+
+		private:
+			friend class Bundle;
+
+			struct Operation
+			{
+				enum Kind
+				{
+					Add,
+					Replace,
+					Remove,
+					DebugInfo
+				};
+
+				Kind kind;
+				uint32_t resourceID;
+				ResourceType resourceType; // Add only
+				EntryData data; // Add and Replace
+				EntryDebugInfo debugInfo; // DebugInfo only
+			};
+
+			explicit Edit(Bundle &bundle);
+
+			Bundle *m_bundle;
+			std::vector<Operation> m_operations;
+		};
+
 
 		LIBBNDL_EXPORT Bundle() = default;
 		LIBBNDL_EXPORT Bundle(MagicVersion magicVersion, uint32_t revisionNumber, Platform platform, Flags flags); // For creating new bundles
 
+		// Copies are snapshots costing about one entry table: block payloads are never modified in place, so both
+		// bundles share them and only blocks replaced afterwards are new. The statistics collector, access
+		// recorder and trace sink are shared with the original too.
+		LIBBNDL_EXPORT Bundle(const Bundle &) = default;
+		LIBBNDL_EXPORT Bundle &operator=(const Bundle &) = default;
+		LIBBNDL_EXPORT Bundle(Bundle &&) = default;
+		LIBBNDL_EXPORT Bundle &operator=(Bundle &&) = default;
+
+		// Fails without touching the bundle if the file can't be read or isn't a bundle, and leaves it empty if parsing fails.
 		LIBBNDL_EXPORT bool Load(const std::string &name);
 		LIBBNDL_EXPORT bool Save(const std::string &name);
+		LIBBNDL_EXPORT bool Save(const std::string &name, const SaveOptions &options, SaveReport *report = nullptr);
+
+		LIBBNDL_EXPORT StorageMode GetStorageMode() const
+		{
+			return m_storageMode;
+		}
+
+		// Off (SeparateBlocks) by default. Takes effect on the next Load.
+		LIBBNDL_EXPORT void SetStorageMode(StorageMode storageMode)
+		{
+			m_storageMode = storageMode;
+		}
+
+		// Off by default. While off, the cost is a null check at each place that would record something.
+		LIBBNDL_EXPORT void EnableStatistics(bool enable);
+		LIBBNDL_EXPORT bool IsStatisticsEnabled() const
+		{
+			return m_statistics != nullptr;
+		}
+
+		// A snapshot of everything recorded since statistics were enabled or last reset.
+		LIBBNDL_EXPORT std::optional<Statistics> GetStatistics() const;
+		LIBBNDL_EXPORT void ResetStatistics();
+
+		// Off by default; an empty directory turns it off again. Blocks GetBinary and the other whole-block reads inflate
+		// from a loaded bundle are kept there, keyed by the file's path, size and modification time, and read back
+		// instead of inflated next time, by this or any later process. Least recently used files go once maxSize is exceeded.
+		LIBBNDL_EXPORT void SetCacheDirectory(const std::string &directory, uint64_t maxSize = 1ULL << 30);
+
+		LIBBNDL_EXPORT MemoryFootprint GetMemoryFootprint() const;
+
+		// 0, the default, means no budget. Once block payloads take up more than this, those loaded from the file are
+		// dropped, largest buffers first, and read back from the file on each use for as long as it is unchanged.
+		// A SharedArena file buffer is split into copies of as many of its blocks as fit, and the rest are dropped.
+		// Checked when set and after each Load; the whole file is still read once while loading.
+		// Dropped blocks aren't kept once read back, so each use costs a file read. For compressed bundles,
+		// SetCacheDirectory spares GetBinary, ReadBinary and GetAlignedBinary that read; other reads still go to the file.
+		LIBBNDL_EXPORT void SetMemoryBudget(uint64_t bytes);
+		LIBBNDL_EXPORT uint64_t GetMemoryBudget() const
+		{
+			return m_memoryBudget;
+		}
+
+		// Off by default. Records the order resources are first read in by GetBinary, GetData and the other block reads.
+		LIBBNDL_EXPORT void EnableAccessRecording(bool enable);
+		LIBBNDL_EXPORT bool IsAccessRecordingEnabled() const
+		{
+			return m_accessRecorder != nullptr;
+		}
+
+		LIBBNDL_EXPORT std::vector<uint32_t> GetAccessOrder() const;
+		// Access traces are text files with one hex resource ID per line. Loading fails on any other line.
+		LIBBNDL_EXPORT bool SaveAccessTrace(const std::string &name) const;
+		LIBBNDL_EXPORT static std::optional<std::vector<uint32_t>> LoadAccessTrace(const std::string &name);
+
+		// Each root followed by what it depends on, depth first, visiting every resource once.
+		LIBBNDL_EXPORT std::vector<uint32_t> GetDependencyOrder(const std::vector<uint32_t> &roots) const;
+
+		// Phases of Load, Save, GetBinary and resource edits are reported here. nullptr turns tracing off.
+		LIBBNDL_EXPORT void SetTraceSink(std::shared_ptr<TraceSink> traceSink)
+		{
+			m_traceSink = std::move(traceSink);
+		}
 
 		LIBBNDL_EXPORT MagicVersion GetMagicVersion() const
 		{
@@ -237,20 +644,154 @@ namespace libbndl
 		LIBBNDL_EXPORT std::optional<EntryData> GetData(uint32_t resourceID) const;
 		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinary(const std::string &resourceName, uint32_t fileBlock) const;
 		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinary(uint32_t resourceID, uint32_t fileBlock) const;
+		// Inflates straight into the caller's memory, which must hold at least the block's uncompressed size.
+		LIBBNDL_EXPORT bool ReadBinary(const std::string &resourceName, uint32_t fileBlock, uint8_t *buffer, size_t size) const;
+		LIBBNDL_EXPORT bool ReadBinary(uint32_t resourceID, uint32_t fileBlock, uint8_t *buffer, size_t size) const;
+		// Aligned to the block's declared alignment, for handing straight to SIMD code or GPU uploads.
+		LIBBNDL_EXPORT std::optional<AlignedBuffer> GetAlignedBinary(const std::string &resourceName, uint32_t fileBlock, bool allowHugePages = false) const;
+		LIBBNDL_EXPORT std::optional<AlignedBuffer> GetAlignedBinary(uint32_t resourceID, uint32_t fileBlock, bool allowHugePages = false) const;
+		// Only inflates up to the first size bytes, for peeking at headers.
+		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinaryPrefix(const std::string &resourceName, uint32_t fileBlock, size_t size) const;
+		LIBBNDL_EXPORT std::unique_ptr<std::vector<uint8_t>> GetBinaryPrefix(uint32_t resourceID, uint32_t fileBlock, size_t size) const;
+		// For blocks too large to inflate in one go. The reader stays usable after the bundle changes.
+		LIBBNDL_EXPORT std::optional<BlockReader> OpenBinary(const std::string &resourceName, uint32_t fileBlock) const;
+		LIBBNDL_EXPORT std::optional<BlockReader> OpenBinary(uint32_t resourceID, uint32_t fileBlock) const;
 
 		LIBBNDL_EXPORT bool AddResource(const std::string &resourceName, const EntryData &data, ResourceType resourceType);
 		LIBBNDL_EXPORT bool AddResource(uint32_t resourceID, const EntryData &data, ResourceType resourceType);
+		// Take over the data's buffers instead of copying them where possible. Data that is rejected is left untouched.
+		// BND2 stores dependencies at the end of block 0, so entries with dependencies and no block 0 are rejected.
+		LIBBNDL_EXPORT bool AddResource(const std::string &resourceName, EntryData &&data, ResourceType resourceType);
+		LIBBNDL_EXPORT bool AddResource(uint32_t resourceID, EntryData &&data, ResourceType resourceType);
 		LIBBNDL_EXPORT bool AddDebugInfo(const std::string &resourceName, const std::string &name, const std::string &type);
 		LIBBNDL_EXPORT bool AddDebugInfo(uint32_t resourceID, const std::string &name, const std::string &type);
 
 		LIBBNDL_EXPORT bool ReplaceResource(const std::string &resourceName, const EntryData &data);
 		LIBBNDL_EXPORT bool ReplaceResource(uint32_t resourceID, const EntryData &data);
+		LIBBNDL_EXPORT bool ReplaceResource(const std::string &resourceName, EntryData &&data);
+		LIBBNDL_EXPORT bool ReplaceResource(uint32_t resourceID, EntryData &&data);
+
+		// Stores pre-compressed blocks as they are (or inflated, for uncompressed bundles).
+		// With verify set, the start of every block is inflated as a sanity check first.
+		LIBBNDL_EXPORT bool AddCompressedResource(const std::string &resourceName, CompressedEntryData &&data, ResourceType resourceType, bool verify = false);
+		LIBBNDL_EXPORT bool AddCompressedResource(uint32_t resourceID, CompressedEntryData &&data, ResourceType resourceType, bool verify = false);
+		LIBBNDL_EXPORT bool ReplaceCompressedResource(const std::string &resourceName, CompressedEntryData &&data, bool verify = false);
+		LIBBNDL_EXPORT bool ReplaceCompressedResource(uint32_t resourceID, CompressedEntryData &&data, bool verify = false);
+
+		// Drops the resource along with its debug info.
+		LIBBNDL_EXPORT bool RemoveResource(const std::string &resourceName);
+		LIBBNDL_EXPORT bool RemoveResource(uint32_t resourceID);
+
+		// For many changes at once; see Edit.
+		LIBBNDL_EXPORT Edit BeginEdit();
+		// Does the deflating AddResource would, without touching the bundle, so it can run on several threads at once.
+		LIBBNDL_EXPORT std::optional<CompressedEntryData> CompressResource(const EntryData &data) const;
+
+		// zlib level used when compressing resources, from 0 (store) to 9 (smallest, the default).
+		LIBBNDL_EXPORT int GetCompressionLevel() const
+		{
+			return m_compressionLevel;
+		}
+
+		LIBBNDL_EXPORT void SetCompressionLevel(int compressionLevel)
+		{
+			m_compressionLevel = compressionLevel;
+		}
 
 		LIBBNDL_EXPORT std::vector<uint32_t> ListResourceIDs() const;
-		LIBBNDL_EXPORT std::map<ResourceType, std::vector<uint32_t>> ListResourceIDsByType() const;
+		// The ID the overloads taking a resource name look up.
+		LIBBNDL_EXPORT static uint32_t HashResourceName(std::string resourceName);
+		LIBBNDL_EXPORT const std::map<ResourceType, std::vector<uint32_t>> &ListResourceIDsByType() const
+		{
+			return m_resourceIDsByType;
+		}
+
+		// Views stay valid until the bundle is next modified or loaded.
+		LIBBNDL_EXPORT EntryRange Entries() const;
+		LIBBNDL_EXPORT EntryRange Entries(ResourceType resourceType) const;
+		LIBBNDL_EXPORT std::optional<EntryView> GetEntry(const std::string &resourceName) const;
+		LIBBNDL_EXPORT std::optional<EntryView> GetEntry(uint32_t resourceID) const;
+
+		LIBBNDL_EXPORT size_t GetResourceCount() const
+		{
+			return m_entries.Size();
+		}
+
+		LIBBNDL_EXPORT SizeTotals GetSizeTotals() const;
+		LIBBNDL_EXPORT SizeTotals GetSizeTotals(ResourceType resourceType) const;
 
 	private:
-		std::map<uint32_t, Entry>	m_entries;
+		// A block payload, which may live inside a buffer shared with other blocks.
+		struct BlockStorage
+		{
+			static constexpr uint64_t NotInFile = ~0ULL;
+
+			std::shared_ptr<const std::vector<uint8_t>> buffer;
+			size_t offset;
+			uint64_t fileOffset = NotInFile; // Where the bytes are in the loaded file, for blocks that haven't been replaced since
+
+			const uint8_t *Data() const
+			{
+				return buffer->data() + offset;
+			}
+
+			// False for empty blocks. Released blocks have no buffer but are still in the file.
+			bool HasData() const
+			{
+				return buffer != nullptr || fileOffset != NotInFile;
+			}
+		};
+
+		// Entry metadata is stored column-wise and sorted by resource ID, so scans only touch the columns they need.
+		struct EntryTable
+		{
+			std::vector<uint32_t> resourceIDs;
+			std::vector<uint32_t> checksums; // Stored in bundle as 64-bit (8-byte)
+			std::vector<ResourceType> resourceTypes;
+			std::vector<uint32_t> dependenciesOffsets;
+			std::vector<uint16_t> numberOfDependencies;
+			std::vector<uint32_t> uncompressedSizes[3];
+			std::vector<uint32_t> uncompressedAlignments[3]; // default depending on file type
+			std::vector<uint32_t> compressedSizes[3];
+
+			// Payloads, kept apart from the metadata above.
+			std::vector<BlockStorage> blockData[3];
+
+			size_t Size() const
+			{
+				return resourceIDs.size();
+			}
+
+			std::optional<size_t> Find(uint32_t resourceID) const;
+			size_t Insert(uint32_t resourceID);
+			void Erase(size_t row);
+			// Both take sorted rows or IDs, and touch every column once however many there are.
+			void EraseRows(const std::vector<size_t> &rows);
+			std::vector<size_t> InsertRows(const std::vector<uint32_t> &resourceIDs);
+			size_t GetMemoryUsage() const;
+			void Clear();
+			void Reserve(size_t size);
+
+		private:
+			template <typename Func>
+			void ForEachColumn(Func &&func);
+		};
+
+		// An entry as it will be stored, ready to go into the entry table.
+		struct EncodedEntry
+		{
+			BlockStorage blockData[3];
+			uint32_t uncompressedSizes[3];
+			uint32_t uncompressedAlignments[3];
+			uint32_t compressedSizes[3];
+			uint32_t dependenciesOffset;
+			uint16_t numberOfDependencies;
+			std::vector<Dependency> dependencies; // BNDL keeps these outside of the data.
+			Statistics::Counters counters = {}; // Work done encoding, recorded once the type is known.
+		};
+
+		EntryTable					m_entries;
+		std::map<ResourceType, std::vector<uint32_t>> m_resourceIDsByType; // sorted, kept up to date with m_entries
 		std::map<uint32_t, EntryDebugInfo> m_debugInfoEntries;
 		std::map<uint32_t, std::vector<Dependency>> m_dependencies; // not used in bnd2 due to lazy reading.
 
@@ -258,14 +799,49 @@ namespace libbndl
 		uint32_t					m_revisionNumber;
 		Platform					m_platform;
 		Flags						m_flags;
+		StorageMode					m_storageMode = SeparateBlocks;
+		int							m_compressionLevel = 9;
+		std::shared_ptr<StatisticsCollector> m_statistics; // nullptr while disabled
+		std::shared_ptr<TraceSink>	m_traceSink;
+		std::shared_ptr<AccessRecorder> m_accessRecorder; // nullptr while disabled
+		std::shared_ptr<DiskCache>	m_diskCache; // nullptr while disabled
+
+		// The file the bundle was last loaded from, as it was then.
+		struct SourceFile
+		{
+			std::string path;
+			uint64_t size;
+			int64_t modified; // Filesystem clock ticks
+			uint64_t key; // Hash of the above, naming this version of the file in the disk cache
+		};
+		std::optional<SourceFile>	m_sourceFile;
+		uint64_t					m_memoryBudget = 0;
+
+		static std::optional<SourceFile> DescribeSourceFile(const std::string &name, uint64_t size);
+
+		void RebuildTypeIndex();
+		bool ReadBlock(size_t row, uint32_t fileBlock, uint8_t *buffer, bool allocated) const;
+		std::optional<BlockReader> OpenBlock(size_t row, uint32_t fileBlock) const;
+		// The block with its stored bytes in memory, read back from the file if it was released.
+		std::optional<BlockStorage> AcquireBlock(size_t row, uint32_t fileBlock) const;
+		void EnforceMemoryBudget();
+		bool RestoreReleasedBlocks();
+		std::optional<std::vector<Dependency>> ReadEntryDependencies(size_t row) const;
+		bool EncodeEntry(const EntryData &data, std::unique_ptr<std::vector<uint8_t>> *ownedBlocks, EncodedEntry &encoded) const;
+		size_t BuildDependencyTable(const EntryData &data, uint32_t fileBlock, std::vector<uint8_t> &dependencyTable) const;
+		bool DeflateBlock(const std::vector<uint8_t> &input, size_t dataSize, const std::vector<uint8_t> &dependencyTable, std::vector<uint8_t> &out, Statistics::Counters &counters) const;
+		bool EncodeCompressedEntry(CompressedEntryData &&data, bool verify, EncodedEntry &encoded) const;
+		void StoreEntry(size_t row, EncodedEntry &&encoded);
+		void InsertEntry(uint32_t resourceID, ResourceType resourceType, EncodedEntry &&encoded);
+		EntryView MakeEntryView(size_t row, const EntryDebugInfo *debugInfo) const;
+
+		BlockStorage StoreBlock(const std::shared_ptr<const std::vector<uint8_t>> &fileBuffer, size_t offset, size_t size) const;
 
-		bool LoadBND2(binaryio::BinaryReader &reader);
-		bool LoadBNDL(binaryio::BinaryReader &reader);
-		bool SaveBND2(binaryio::BinaryWriter &writer);
+		bool LoadBND2(binaryio::BinaryReader &reader, const std::shared_ptr<const std::vector<uint8_t>> &fileBuffer);
+		bool LoadBNDL(binaryio::BinaryReader &reader, const std::shared_ptr<const std::vector<uint8_t>> &fileBuffer);
+		bool SaveBND2(binaryio::BinaryWriter &writer, const SaveOptions &options, SaveReport &report);
 		bool SaveBNDL(binaryio::BinaryWriter &writer);
-		uint32_t HashResourceName(std::string resourceName) const;
 
 		static Dependency ReadDependency(binaryio::BinaryReader &reader);
-		static void WriteDependency(binaryio::BinaryWriter &writer, const Dependency &dependency);
 	};
 }
@@ -0,0 +1,75 @@
+#include "accessrecorder.hpp"
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+
+using namespace libbndl;
+
+void AccessRecorder::Record(uint32_t resourceID)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_seen.insert(resourceID).second)
+		m_order.push_back(resourceID);
+}
+
+std::vector<uint32_t> AccessRecorder::Order() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_order;
+}
+
+void Bundle::EnableAccessRecording(bool enable)
+{
+	if (!enable)
+		m_accessRecorder.reset();
+	else if (m_accessRecorder == nullptr)
+		m_accessRecorder = std::make_shared<AccessRecorder>();
+}
+
+std::vector<uint32_t> Bundle::GetAccessOrder() const
+{
+	if (m_accessRecorder == nullptr)
+		return {};
+
+	return m_accessRecorder->Order();
+}
+
+bool Bundle::SaveAccessTrace(const std::string &name) const
+{
+	std::ofstream f(name);
+	if (!f)
+		return false;
+
+	f << std::hex << std::setfill('0');
+	for (const auto resourceID : GetAccessOrder())
+		f << std::setw(8) << resourceID << '\n';
+
+	return static_cast<bool>(f);
+}
+
+std::optional<std::vector<uint32_t>> Bundle::LoadAccessTrace(const std::string &name)
+{
+	std::ifstream f(name);
+	if (!f)
+		return {};
+
+	std::vector<uint32_t> order;
+	std::string line;
+	while (std::getline(f, line))
+	{
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty())
+			continue;
+
+		// The whole line has to be one 32-bit hex ID; anything else means the file isn't a trace.
+		uint32_t resourceID;
+		const auto end = line.data() + line.size();
+		const auto result = std::from_chars(line.data(), end, resourceID, 16);
+		if (result.ec != std::errc() || result.ptr != end)
+			return {};
+		order.push_back(resourceID);
+	}
+
+	return order;
+}
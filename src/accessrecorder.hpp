@@ -0,0 +1,20 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <mutex>
+#include <unordered_set>
+
+namespace libbndl
+{
+	// Remembers the order resources are first read in. Shared between copies of a bundle like the statistics collector.
+	class AccessRecorder
+	{
+	public:
+		void Record(uint32_t resourceID);
+		std::vector<uint32_t> Order() const;
+
+	private:
+		mutable std::mutex m_mutex;
+		std::vector<uint32_t> m_order;
+		std::unordered_set<uint32_t> m_seen;
+	};
+}
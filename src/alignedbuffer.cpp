@@ -0,0 +1,118 @@
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#	include <malloc.h>
+#elif defined(__linux__)
+#	include <sys/mman.h>
+#endif
+
+using namespace libbndl;
+
+namespace
+{
+#if defined(__linux__)
+	constexpr size_t HugePageSize = 2 * 1024 * 1024;
+
+	// Maps more than needed and trims it back so the start lands on a huge page boundary.
+	uint8_t *MapHugePages(size_t size, size_t &mappedSize)
+	{
+		mappedSize = (size + HugePageSize - 1) & ~(HugePageSize - 1);
+
+		const auto reserveSize = mappedSize + HugePageSize;
+		auto reserved = mmap(nullptr, reserveSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (reserved == MAP_FAILED)
+			return nullptr;
+
+		const auto start = reinterpret_cast<uintptr_t>(reserved);
+		const auto aligned = (start + HugePageSize - 1) & ~(HugePageSize - 1);
+		if (aligned != start)
+			munmap(reserved, aligned - start);
+		if (const auto tail = start + reserveSize - (aligned + mappedSize))
+			munmap(reinterpret_cast<void *>(aligned + mappedSize), tail);
+
+		// Only a hint; the kernel may still back it with normal pages.
+		madvise(reinterpret_cast<void *>(aligned), mappedSize, MADV_HUGEPAGE);
+
+		return reinterpret_cast<uint8_t *>(aligned);
+	}
+#endif
+}
+
+Bundle::AlignedBuffer::AlignedBuffer(size_t size, size_t alignment, bool allowHugePages)
+	: m_size(size), m_alignment(std::max(alignment, alignof(std::max_align_t)))
+{
+	// Alignments come from a 4-bit shift, so anything else is a caller mistake.
+	if ((m_alignment & (m_alignment - 1)) != 0 || size == 0)
+		return;
+
+#if defined(__linux__)
+	if (allowHugePages && size >= HugePageSize && m_alignment <= HugePageSize)
+	{
+		m_data = MapHugePages(size, m_mappedSize);
+		if (m_data != nullptr)
+			return;
+		m_mappedSize = 0;
+	}
+#endif
+
+#if defined(_WIN32)
+	m_data = static_cast<uint8_t *>(_aligned_malloc(size, m_alignment));
+#else
+	void *data = nullptr;
+	if (posix_memalign(&data, m_alignment, size) == 0)
+		m_data = static_cast<uint8_t *>(data);
+#endif
+}
+
+Bundle::AlignedBuffer::AlignedBuffer(AlignedBuffer &&other) noexcept
+	: m_data(other.m_data), m_size(other.m_size), m_alignment(other.m_alignment), m_mappedSize(other.m_mappedSize)
+{
+	other.m_data = nullptr;
+	other.m_size = 0;
+	other.m_mappedSize = 0;
+}
+
+Bundle::AlignedBuffer &Bundle::AlignedBuffer::operator=(AlignedBuffer &&other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+		m_data = other.m_data;
+		m_size = other.m_size;
+		m_alignment = other.m_alignment;
+		m_mappedSize = other.m_mappedSize;
+		other.m_data = nullptr;
+		other.m_size = 0;
+		other.m_mappedSize = 0;
+	}
+
+	return *this;
+}
+
+Bundle::AlignedBuffer::~AlignedBuffer()
+{
+	Release();
+}
+
+void Bundle::AlignedBuffer::Release()
+{
+	if (m_data == nullptr)
+		return;
+
+#if defined(__linux__)
+	if (m_mappedSize != 0)
+		munmap(m_data, m_mappedSize);
+	else
+		std::free(m_data);
+#elif defined(_WIN32)
+	_aligned_free(m_data);
+#else
+	std::free(m_data);
+#endif
+
+	m_data = nullptr;
+}
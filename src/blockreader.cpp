@@ -0,0 +1,95 @@
+#include <libbndl/bundle.hpp>
+#include "statistics.hpp"
+#include <zlib.h>
+#include <algorithm>
+#include <cstring>
+
+using namespace libbndl;
+
+struct Bundle::BlockReader::Inflater
+{
+	z_stream stream = {};
+	bool initialised = false;
+
+	~Inflater()
+	{
+		if (initialised)
+			inflateEnd(&stream);
+	}
+};
+
+Bundle::BlockReader::BlockReader(std::shared_ptr<const std::vector<uint8_t>> buffer, const uint8_t *data, size_t storedSize, size_t size, bool compressed,
+	std::shared_ptr<StatisticsCollector> statistics, ResourceType resourceType)
+	: m_buffer(std::move(buffer)), m_data(data), m_storedSize(storedSize), m_size(size), m_statistics(std::move(statistics)), m_resourceType(resourceType)
+{
+	if (!compressed)
+		return;
+
+	m_inflater = std::make_unique<Inflater>();
+	m_inflater->stream.next_in = const_cast<Bytef *>(m_data);
+	m_inflater->stream.avail_in = static_cast<uInt>(m_storedSize);
+	m_inflater->initialised = inflateInit(&m_inflater->stream) == Z_OK;
+	m_good = m_inflater->initialised;
+}
+
+Bundle::BlockReader::BlockReader(BlockReader &&other) noexcept = default;
+Bundle::BlockReader &Bundle::BlockReader::operator=(BlockReader &&other) noexcept = default;
+Bundle::BlockReader::~BlockReader() = default;
+
+size_t Bundle::BlockReader::Read(uint8_t *buffer, size_t size)
+{
+	size = std::min(size, m_size - m_position);
+	if (!m_good || size == 0)
+		return 0;
+
+	if (m_inflater == nullptr)
+	{
+		std::memcpy(buffer, m_data + m_position, size);
+		m_position += size;
+
+		if (m_statistics)
+		{
+			Statistics::Counters counters = {};
+			counters.bytesRead = size;
+			m_statistics->Record(m_resourceType, counters);
+		}
+
+		return size;
+	}
+
+	const auto start = m_statistics ? StatisticsCollector::Clock::now() : StatisticsCollector::Clock::time_point();
+	auto &stream = m_inflater->stream;
+	const auto availableIn = stream.avail_in;
+	stream.next_out = buffer;
+	stream.avail_out = static_cast<uInt>(size);
+
+	while (stream.avail_out > 0)
+	{
+		const auto ret = inflate(&stream, Z_NO_FLUSH);
+		if (ret == Z_STREAM_END)
+		{
+			// The stream can't end before the size it was stored with.
+			m_good = stream.avail_out == 0 && m_position + size == m_size;
+			break;
+		}
+		if (ret != Z_OK)
+		{
+			m_good = false;
+			break;
+		}
+	}
+
+	const auto produced = size - stream.avail_out;
+	m_position += produced;
+
+	if (m_statistics)
+	{
+		Statistics::Counters counters = {};
+		counters.bytesRead = availableIn - stream.avail_in;
+		counters.bytesInflated = produced;
+		counters.inflateNanoseconds = StatisticsCollector::NanosecondsSince(start);
+		m_statistics->Record(m_resourceType, counters);
+	}
+
+	return produced;
+}
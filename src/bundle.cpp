@@ -2,15 +2,156 @@
 #include <binaryio/binaryreader.hpp>
 #include <binaryio/binarywriter.hpp>
 #include <fstream>
+#include <filesystem>
 #include <cassert>
 #include <zlib.h>
 #include <pugixml.hpp>
 #include <regex>
 #include <iomanip>
 #include <array>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <string_view>
+#include <unordered_map>
+#include "byteswap.hpp"
+#include "statistics.hpp"
+#include "trace.hpp"
+#include "accessrecorder.hpp"
+#include "diskcache.hpp"
 
 using namespace libbndl;
 
+namespace
+{
+	// On-disk layout of a BND2 ID block entry, as 32-bit words.
+	struct IDBlockRecord
+	{
+		uint32_t resourceID[2]; // 64-bit
+		uint32_t checksum[2]; // 64-bit
+		uint32_t uncompressedSizes[3];
+		uint32_t compressedSizes[3];
+		uint32_t dataOffsets[3];
+		uint32_t dependenciesOffset;
+		uint32_t resourceType;
+		uint32_t numberOfDependencies; // 16-bit, followed by 2 bytes of padding
+	};
+	static_assert(sizeof(IDBlockRecord) == 0x40, "BND2 ID block entries are 64 bytes");
+
+	// On-disk layout of a BND2 dependency, as 32-bit words.
+	struct DependencyRecord
+	{
+		uint32_t resourceID[2]; // 64-bit
+		uint32_t internalOffset;
+		uint32_t padding;
+	};
+	static_assert(sizeof(DependencyRecord) == 0x10, "BND2 dependencies are 16 bytes");
+
+	inline size_t AlignOffset(size_t offset, size_t alignment)
+	{
+		return (offset + alignment - 1) & ~(alignment - 1);
+	}
+
+	std::vector<Bundle::Dependency> ReadDependencies(const uint8_t *buffer, size_t count, bool bigEndian)
+	{
+		std::vector<DependencyRecord> records(count);
+		std::memcpy(records.data(), buffer, count * sizeof(DependencyRecord));
+		if (bigEndian)
+			ByteSwap32Array(reinterpret_cast<uint32_t *>(records.data()), count * sizeof(DependencyRecord) / sizeof(uint32_t));
+
+		const auto lowWord = bigEndian ? 1 : 0;
+		std::vector<Bundle::Dependency> dependencies(count);
+		for (auto i = 0U; i < count; i++)
+			dependencies[i] = { records[i].resourceID[lowWord], records[i].internalOffset };
+		return dependencies;
+	}
+
+	// Deflates the concatenation of the given buffers as one zlib stream.
+	bool Deflate(std::initializer_list<std::pair<const uint8_t *, size_t>> segments, int level, std::vector<uint8_t> &out)
+	{
+		size_t totalSize = 0;
+		for (const auto &segment : segments)
+			totalSize += segment.second;
+
+		z_stream stream = {};
+		if (deflateInit(&stream, level) != Z_OK)
+			return false;
+
+		out.resize(deflateBound(&stream, static_cast<uLong>(totalSize)));
+		stream.next_out = out.data();
+		stream.avail_out = static_cast<uInt>(out.size());
+
+		auto ret = Z_OK;
+		for (const auto &segment : segments)
+		{
+			if (segment.second == 0)
+				continue;
+
+			stream.next_in = const_cast<Bytef *>(segment.first);
+			stream.avail_in = static_cast<uInt>(segment.second);
+			ret = deflate(&stream, Z_NO_FLUSH);
+			if (ret != Z_OK)
+				break;
+		}
+
+		while (ret == Z_OK)
+		{
+			ret = deflate(&stream, Z_FINISH);
+			if (ret == Z_OK || ret == Z_BUF_ERROR)
+			{
+				// Out of room despite deflateBound; grow and carry on.
+				const auto written = out.size() - stream.avail_out;
+				out.resize(out.size() * 2);
+				stream.next_out = out.data() + written;
+				stream.avail_out = static_cast<uInt>(out.size() - written);
+				ret = Z_OK;
+			}
+		}
+
+		out.resize(stream.total_out);
+		deflateEnd(&stream);
+
+		return ret == Z_STREAM_END;
+	}
+
+	// Inflates until the output is full or the stream ends, returning the zlib status and how much was produced.
+	int InflatePrefix(const uint8_t *in, size_t inSize, uint8_t *out, size_t &outSize)
+	{
+		z_stream stream = {};
+		if (inflateInit(&stream) != Z_OK)
+			return Z_MEM_ERROR;
+
+		stream.next_in = const_cast<Bytef *>(in);
+		stream.avail_in = static_cast<uInt>(inSize);
+		stream.next_out = out;
+		stream.avail_out = static_cast<uInt>(outSize);
+
+		const auto ret = inflate(&stream, Z_SYNC_FLUSH);
+		outSize = stream.total_out;
+		inflateEnd(&stream);
+
+		return ret;
+	}
+
+	void WriteDependencies(uint8_t *buffer, const std::vector<Bundle::Dependency> &dependencies, bool bigEndian)
+	{
+		const auto lowWord = bigEndian ? 1 : 0;
+		std::vector<DependencyRecord> records(dependencies.size());
+		for (auto i = 0U; i < dependencies.size(); i++)
+		{
+			records[i].resourceID[lowWord] = dependencies[i].resourceID;
+			records[i].resourceID[1 - lowWord] = 0;
+			records[i].internalOffset = dependencies[i].internalOffset;
+			records[i].padding = 0;
+		}
+
+		const auto size = records.size() * sizeof(DependencyRecord);
+		if (bigEndian)
+			ByteSwap32Array(reinterpret_cast<uint32_t *>(records.data()), size / sizeof(uint32_t));
+		std::memcpy(buffer, records.data(), size);
+	}
+}
+
 #ifndef __has_builtin
 #	define __has_builtin(x) 0
 #endif
@@ -39,6 +180,9 @@ Bundle::Bundle(MagicVersion magicVersion, uint32_t revisionNumber, Platform plat
 
 bool Bundle::Load(const std::string &name)
 {
+	TraceScope trace(m_traceSink, "Load");
+	TraceScope readTrace(m_traceSink, "ReadFile");
+
 	std::ifstream stream;
 
 	stream.open(name, std::ios::in | std::ios::binary | std::ios::ate);
@@ -52,8 +196,18 @@ bool Bundle::Load(const std::string &name)
 	const auto &buffer = std::make_shared<std::vector<uint8_t>>(fileSize);
 	stream.read(reinterpret_cast<char *>(buffer->data()), fileSize);
 	stream.close();
+	readTrace.End();
 	auto reader = binaryio::BinaryReader(buffer);
 
+	if (m_statistics)
+	{
+		Statistics::Counters counters = {};
+		counters.bytesRead = buffer->size();
+		counters.allocations = 1;
+		counters.allocatedBytes = buffer->size();
+		m_statistics->Record(counters);
+	}
+
 	// Check if it's a BNDL archive
 	auto magic = reader.ReadString(4);
 	if (magic == std::string("bndl"))
@@ -63,18 +217,55 @@ bool Bundle::Load(const std::string &name)
 	else
 		return false;
 
-	return (m_magicVersion == BNDL) ? LoadBNDL(reader): LoadBND2(reader);
+	const auto loaded = (m_magicVersion == BNDL) ? LoadBNDL(reader, buffer) : LoadBND2(reader, buffer);
+	if (!loaded)
+	{
+		// Parsing stopped partway, so neither the old file's entries nor the new one's can be trusted.
+		m_entries.Clear();
+		m_debugInfoEntries.clear();
+		m_dependencies.clear();
+		m_sourceFile.reset();
+		RebuildTypeIndex();
+		return false;
+	}
+
+	// Only now do the entries' file offsets point into this file.
+	m_sourceFile = DescribeSourceFile(name, buffer->size());
+	RebuildTypeIndex();
+	EnforceMemoryBudget();
+
+	return true;
+}
+
+Bundle::BlockStorage Bundle::StoreBlock(const std::shared_ptr<const std::vector<uint8_t>> &fileBuffer, size_t offset, size_t size) const
+{
+	if (m_storageMode == SharedArena)
+		return { fileBuffer, offset, offset };
+
+	if (m_statistics)
+	{
+		Statistics::Counters counters = {};
+		counters.allocations = 1;
+		counters.allocatedBytes = size;
+		m_statistics->Record(counters);
+	}
+
+	const auto begin = fileBuffer->begin() + offset;
+	return { std::make_shared<const std::vector<uint8_t>>(begin, begin + size), 0, offset };
 }
 
-bool Bundle::LoadBND2(binaryio::BinaryReader &reader)
+bool Bundle::LoadBND2(binaryio::BinaryReader &reader, const std::shared_ptr<const std::vector<uint8_t>> &fileBuffer)
 {
+	const auto &buffer = *fileBuffer;
+	TraceScope trace(m_traceSink, "Header");
+
 	m_revisionNumber = reader.Read<uint32_t>();
 
 	m_platform = reader.Read<Platform>();
 	reader.SetBigEndian(m_platform != PC);
 
 	if (reader.IsBigEndian())
-		m_revisionNumber = (m_revisionNumber << 24) | (m_revisionNumber << 8 & 0xff0000) | (m_revisionNumber >> 8 & 0xff00) | (m_revisionNumber >> 24);
+		m_revisionNumber = ByteSwap32(m_revisionNumber);
 	// Little sanity check.
 	if (m_revisionNumber != 2)
 		return false;
@@ -93,59 +284,63 @@ bool Bundle::LoadBND2(binaryio::BinaryReader &reader)
 	// Last 8 bytes are padding.
 
 
-	m_entries.clear();
+	m_entries.Clear();
 	m_debugInfoEntries.clear();
+	m_dependencies.clear();
 
-	reader.Seek(idBlockOffset);
-	for (auto i = 0U; i < numEntries; i++)
+	trace.Next("IDBlock"); // Includes storing the data blocks.
+
+	// Decode the whole ID block in one go rather than field by field.
+	const auto idBlockSize = static_cast<size_t>(numEntries) * sizeof(IDBlockRecord);
+	if (idBlockOffset > buffer.size() || buffer.size() - idBlockOffset < idBlockSize)
+		return false;
+
+	std::vector<IDBlockRecord> records(numEntries);
+	std::memcpy(records.data(), buffer.data() + idBlockOffset, idBlockSize);
+	if (reader.IsBigEndian())
+		ByteSwap32Array(reinterpret_cast<uint32_t *>(records.data()), idBlockSize / sizeof(uint32_t));
+
+	// After swapping each 32-bit word, the low half of a 64-bit value and the 16-bit dependency count sit at different places.
+	const auto lowWord = reader.IsBigEndian() ? 1 : 0;
+	const auto dependencyCountShift = reader.IsBigEndian() ? 16 : 0;
+
+	m_entries.Reserve(numEntries);
+	for (const auto &record : records)
 	{
 		// These are stored in bundle as 64-bit (8-byte), but are really 32-bit.
-		auto resourceID = static_cast<uint32_t>(reader.Read<uint64_t>());
+		const auto resourceID = record.resourceID[lowWord];
 		assert(resourceID != 0);
-		auto &e = m_entries[resourceID];
-		e.info.checksum = static_cast<uint32_t>(reader.Read<uint64_t>());
-
-		// The uncompressed sizes have a high nibble that varies depending on the resource type.
-		const auto uncompSize0 = reader.Read<uint32_t>();
-		e.fileBlockData[0].uncompressedSize = uncompSize0 & ~(0xFU << 28);
-		e.fileBlockData[0].uncompressedAlignment = 1 << (uncompSize0 >> 28);
-		const auto uncompSize1 = reader.Read<uint32_t>();
-		e.fileBlockData[1].uncompressedSize = uncompSize1 & ~(0xFU << 28);
-		e.fileBlockData[1].uncompressedAlignment = 1 << (uncompSize1 >> 28);
-		const auto uncompSize2 = reader.Read<uint32_t>();
-		e.fileBlockData[2].uncompressedSize = uncompSize2 & ~(0xFU << 28);
-		e.fileBlockData[2].uncompressedAlignment = 1 << (uncompSize2 >> 28);
-
-		e.fileBlockData[0].compressedSize = reader.Read<uint32_t>();
-		e.fileBlockData[1].compressedSize = reader.Read<uint32_t>();
-		e.fileBlockData[2].compressedSize = reader.Read<uint32_t>();
-
-		auto dataReader = reader.Copy();
+		if (m_entries.Find(resourceID))
+			return false;
+
+		const auto row = m_entries.Insert(resourceID);
+		m_entries.checksums[row] = record.checksum[lowWord];
+
 		for (auto j = 0; j < 3; j++)
 		{
-			dataReader.Seek(fileBlockOffsets[j] + reader.Read<uint32_t>()); // Read offset
+			// The uncompressed sizes have a high nibble that varies depending on the resource type.
+			const auto uncompressedSize = record.uncompressedSizes[j] & ~(0xFU << 28);
+			m_entries.uncompressedSizes[j][row] = uncompressedSize;
+			m_entries.uncompressedAlignments[j][row] = 1 << (record.uncompressedSizes[j] >> 28);
+			m_entries.compressedSizes[j][row] = record.compressedSizes[j];
 
-			auto &dataInfo = e.fileBlockData[j];
-
-			const auto readSize = (m_flags & Compressed) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
+			const auto readSize = (m_flags & Compressed) ? record.compressedSizes[j] : uncompressedSize;
 			if (readSize == 0)
-			{
-				dataInfo.data = nullptr;
 				continue;
-			}
 
-			const auto readBuffer = dataReader.Read<uint8_t *>(readSize);
-			dataInfo.data = std::make_unique<std::vector<uint8_t>>(readBuffer, readBuffer + readSize);
-			delete[] readBuffer;
-		}
+			const auto readOffset = static_cast<size_t>(fileBlockOffsets[j]) + record.dataOffsets[j];
+			if (readOffset > buffer.size() || buffer.size() - readOffset < readSize)
+				return false;
 
-		e.info.dependenciesOffset = reader.Read<uint32_t>();
-		e.info.resourceType = reader.Read<ResourceType>();
-		e.info.numberOfDependencies = reader.Read<uint16_t>();
+			m_entries.blockData[j][row] = StoreBlock(fileBuffer, readOffset, readSize);
+		}
 
-		reader.Seek(2, std::ios::cur); // Padding
+		m_entries.dependenciesOffsets[row] = record.dependenciesOffset;
+		m_entries.resourceTypes[row] = static_cast<ResourceType>(record.resourceType);
+		m_entries.numberOfDependencies[row] = static_cast<uint16_t>(record.numberOfDependencies >> dependencyCountShift);
 	}
 
+	trace.Next("ResourceStringTable");
 	if (m_flags & HasResourceStringTable)
 	{
 		reader.Seek(rstOffset, std::ios::beg);
@@ -168,9 +363,10 @@ bool Bundle::LoadBND2(binaryio::BinaryReader &reader)
 	return true;
 }
 
-bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
+bool Bundle::LoadBNDL(binaryio::BinaryReader &reader, const std::shared_ptr<const std::vector<uint8_t>> &fileBuffer)
 {
 	reader.SetBigEndian(true); // Never released on PC.
+	TraceScope trace(m_traceSink, "Header");
 
 	/*m_revisionNumber = */reader.Read<uint32_t>(); // ???
 	/*if (m_revisionNumber != 5)
@@ -207,29 +403,45 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 	reader.Skip<uint32_t>(); // graphics memory alignment
 
 
-	m_entries.clear();
+	m_entries.Clear();
+	m_debugInfoEntries.clear();
+	m_dependencies.clear();
 
+	trace.Next("IDTable"); // Includes storing the data blocks.
 	reader.Seek(idListOffset);
 	std::vector<uint32_t> resourceIDs;
 	for (auto i = 0U; i < numEntries; i++)
 		resourceIDs.push_back(static_cast<uint32_t>(reader.Read<uint64_t>()));
 
-	reader.Seek(idTableOffset);
+	// The tables below follow the ID list order, which isn't necessarily sorted.
+	auto sortedResourceIDs = resourceIDs;
+	std::sort(sortedResourceIDs.begin(), sortedResourceIDs.end());
+	if (std::adjacent_find(sortedResourceIDs.begin(), sortedResourceIDs.end()) != sortedResourceIDs.end())
+		return false;
+
+	m_entries.Reserve(numEntries);
+	for (const auto resourceID : sortedResourceIDs)
+		m_entries.Insert(resourceID);
+
+	std::vector<size_t> rows;
+	rows.reserve(numEntries);
 	for (const auto resourceID : resourceIDs)
-	{
-		auto &e = m_entries[resourceID];
+		rows.push_back(*m_entries.Find(resourceID));
 
+	reader.Seek(idTableOffset);
+	for (const auto row : rows)
+	{
 		reader.Skip<uint32_t>(); // unknown mem stuff
-		e.info.dependenciesOffset = reader.Read<uint32_t>();
-		e.info.resourceType = reader.Read<ResourceType>();
+		m_entries.dependenciesOffsets[row] = reader.Read<uint32_t>();
+		m_entries.resourceTypes[row] = reader.Read<ResourceType>();
 
 		if (compressed)
 		{
-			e.fileBlockData[0].compressedSize = reader.Read<uint32_t>();
+			m_entries.compressedSizes[0][row] = reader.Read<uint32_t>();
 			reader.Skip<uint32_t>(); // Alignment value, should be 1
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value, should be 1
-			e.fileBlockData[1].compressedSize = reader.Read<uint32_t>();
+			m_entries.compressedSizes[1][row] = reader.Read<uint32_t>();
 			reader.Skip<uint32_t>(); // Alignment value, should be 1
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value, should be 1
@@ -238,20 +450,19 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 		}
 		else
 		{
-			e.fileBlockData[0].uncompressedSize = reader.Read<uint32_t>();
-			e.fileBlockData[0].uncompressedAlignment = reader.Read<uint32_t>();
+			m_entries.uncompressedSizes[0][row] = reader.Read<uint32_t>();
+			m_entries.uncompressedAlignments[0][row] = reader.Read<uint32_t>();
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value
-			e.fileBlockData[1].uncompressedSize = reader.Read<uint32_t>();
-			e.fileBlockData[1].uncompressedAlignment = reader.Read<uint32_t>();
+			m_entries.uncompressedSizes[1][row] = reader.Read<uint32_t>();
+			m_entries.uncompressedAlignments[1][row] = reader.Read<uint32_t>();
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value
 		}
 
-		auto dataReader = reader.Copy();
-		auto dataBlockStartOffset = 0;
+		size_t dataBlockStartOffset = 0;
 		for (auto j = 0; j < 5; j++)
 		{
 			if (j > 0)
@@ -265,20 +476,15 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 
 			auto mappedBlock = j;
 			if (j == 2) mappedBlock = 1;
-			auto &dataInfo = e.fileBlockData[mappedBlock];
 
-			const auto readSize = compressed ? dataInfo.compressedSize : dataInfo.uncompressedSize;
+			const auto readSize = compressed ? m_entries.compressedSizes[mappedBlock][row] : m_entries.uncompressedSizes[mappedBlock][row];
 			if (readSize == 0)
-			{
-				dataInfo.data = nullptr;
 				continue;
-			}
 
-			dataReader.Seek(readOffset); // Read offset
+			if (readOffset > fileBuffer->size() || fileBuffer->size() - readOffset < readSize)
+				return false;
 
-			const auto readBuffer = dataReader.Read<uint8_t *>(readSize);
-			dataInfo.data = std::make_unique<std::vector<uint8_t>>(readBuffer, readBuffer + readSize);
-			delete[] readBuffer;
+			m_entries.blockData[mappedBlock][row] = StoreBlock(fileBuffer, readOffset, readSize);
 		}
 
 		reader.Seek(0x14, std::ios::cur); // Unknown mem stuff
@@ -287,16 +493,14 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 	if (compressed)
 	{
 		reader.Seek(uncompInfoOffset);
-		for (const auto resourceID : resourceIDs)
+		for (const auto row : rows)
 		{
-			auto &e = m_entries[resourceID];
-
-			e.fileBlockData[0].uncompressedSize = reader.Read<uint32_t>();
-			e.fileBlockData[0].uncompressedAlignment = reader.Read<uint32_t>();
+			m_entries.uncompressedSizes[0][row] = reader.Read<uint32_t>();
+			m_entries.uncompressedAlignments[0][row] = reader.Read<uint32_t>();
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value
-			e.fileBlockData[1].uncompressedSize = reader.Read<uint32_t>();
-			e.fileBlockData[1].uncompressedAlignment = reader.Read<uint32_t>();
+			m_entries.uncompressedSizes[1][row] = reader.Read<uint32_t>();
+			m_entries.uncompressedAlignments[1][row] = reader.Read<uint32_t>();
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
 			reader.Skip<uint32_t>(); // Alignment value
 			reader.Skip<uint32_t>(); // other blocks. Maybe used but I'm ignoring it.
@@ -304,20 +508,23 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 		}
 	}
 
-	for (const auto resourceID : resourceIDs)
+	trace.Next("Dependencies");
+	for (auto row = 0U; row < m_entries.Size(); row++)
 	{
-		auto &e = m_entries[resourceID];
-		const auto depOffset = e.info.dependenciesOffset;
+		const auto depOffset = m_entries.dependenciesOffsets[row];
 		if (depOffset == 0)
 			continue;
 
 		reader.Seek(depOffset);
-		e.info.numberOfDependencies = static_cast<uint16_t>(reader.Read<uint32_t>());
+		const auto numberOfDependencies = static_cast<uint16_t>(reader.Read<uint32_t>());
+		m_entries.numberOfDependencies[row] = numberOfDependencies;
 		reader.Verify<uint32_t>(0);
-		for (auto i = 0U; i < e.info.numberOfDependencies; i++)
-			m_dependencies[resourceID].emplace_back(ReadDependency(reader));
+		auto &dependencies = m_dependencies[m_entries.resourceIDs[row]];
+		for (auto i = 0U; i < numberOfDependencies; i++)
+			dependencies.emplace_back(ReadDependency(reader));
 	}
 
+	trace.Next("ResourceStringTable");
 	auto rstFile = GetBinary(0xC039284A, 0);
 	if (rstFile == nullptr)
 		return true;
@@ -346,14 +553,28 @@ bool Bundle::LoadBNDL(binaryio::BinaryReader &reader)
 		}
 	}
 
-	m_entries.erase(0xC039284A);
+	if (const auto rstRow = m_entries.Find(0xC039284A))
+		m_entries.Erase(*rstRow);
 
 	return true;
 }
 
 bool Bundle::Save(const std::string &name)
 {
+	return Save(name, SaveOptions());
+}
+
+bool Bundle::Save(const std::string &name, const SaveOptions &options, SaveReport *report)
+{
+	TraceScope trace(m_traceSink, "Save");
 	auto writer = binaryio::BinaryWriter();
+	SaveReport saveReport;
+
+	// Released blocks can't be read back once the file they come from is overwritten.
+	std::error_code error;
+	const auto overwritesSource = m_sourceFile && std::filesystem::equivalent(name, m_sourceFile->path, error);
+	if (overwritesSource && !RestoreReleasedBlocks())
+		return false;
 
 	switch (m_magicVersion)
 	{
@@ -363,7 +584,7 @@ bool Bundle::Save(const std::string &name)
 		break;
 
 	case BND2:
-		if (!SaveBND2(writer))
+		if (!SaveBND2(writer, options, saveReport))
 			return false;
 		break;
 
@@ -371,24 +592,36 @@ bool Bundle::Save(const std::string &name)
 		return false;
 	}
 
+	TraceScope writeTrace(m_traceSink, "WriteFile");
 	std::ofstream f(name, std::ios::out | std::ios::binary);
 	f << writer.GetStream().rdbuf();
 	f.close();
 
+	// Offsets into the old file mean nothing now.
+	if (overwritesSource)
+		m_sourceFile.reset();
+
+	if (report)
+		*report = saveReport;
+
 	return true;
 }
 
 
-bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
+bool Bundle::SaveBND2(binaryio::BinaryWriter &writer, const SaveOptions &options, SaveReport &report)
 {
+	const auto bigEndian = m_platform != PC;
+	writer.SetBigEndian(bigEndian);
+	TraceScope trace(m_traceSink, "Header");
+
 	writer.Write("bnd2", 4);
 	writer.Write<uint32_t>(2); // Bundle version
-	writer.Write(PC); // Only PC writing supported for now.
+	writer.Write<uint32_t>(bigEndian ? ByteSwap32(m_platform) : m_platform); // Platform is always read as little endian.
 
 	auto rstPointerPos = writer.GetOffset();
 	writer.Seek(4, std::ios::cur); // write later
 
-	writer.Write<uint32_t>(m_entries.size());
+	writer.Write<uint32_t>(static_cast<uint32_t>(m_entries.Size()));
 
 	auto idBlockPointerPos = writer.GetOffset();
 	writer.Seek(4, std::ios::cur); // write later
@@ -405,6 +638,7 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 
 
 	// RESOURCE STRING TABLE
+	trace.Next("ResourceStringTable");
 	writer.VisitAndWrite<uint32_t>(rstPointerPos, writer.GetOffset());
 	if (m_flags & HasResourceStringTable)
 	{
@@ -431,59 +665,131 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 	}
 
 
+	// Lay out the data blocks up front so the ID block can be written in one go.
+	trace.Next("Layout");
+	const auto numEntries = m_entries.Size();
+
+	// Rows in the order their data is written: the layout hint first, then the rest by ID.
+	std::vector<size_t> layout;
+	layout.reserve(numEntries);
+	std::vector<bool> placed(numEntries);
+	for (const auto resourceID : options.layoutOrder)
+	{
+		const auto row = m_entries.Find(resourceID);
+		if (row && !placed[*row])
+		{
+			placed[*row] = true;
+			layout.push_back(*row);
+		}
+	}
+	for (auto j = 0U; j < numEntries; j++)
+	{
+		if (!placed[j])
+			layout.push_back(j);
+	}
+	const auto lastRow = numEntries > 0 ? layout.back() : 0;
+
+	auto dataOffsets = std::vector<std::array<uint32_t, 3>>(numEntries);
+	std::vector<size_t> writtenRows[3]; // Duplicates only get an offset into what is already written.
+	for (auto i = 0; i < 3; i++)
+	{
+		const auto &readSizes = (m_flags & Compressed) ? m_entries.compressedSizes[i] : m_entries.uncompressedSizes[i];
+		std::unordered_map<size_t, std::vector<size_t>> rowsByHash;
+		size_t blockSize = 0;
+		for (const auto j : layout)
+		{
+			const auto readSize = readSizes[j];
+			if (readSize == 0)
+			{
+				dataOffsets[j][i] = 0;
+				continue;
+			}
+
+			if (options.deduplicate)
+			{
+				const auto block = AcquireBlock(j, i);
+				if (!block)
+					return false;
+
+				const auto data = block->Data();
+				auto &candidates = rowsByHash[std::hash<std::string_view>()(std::string_view(reinterpret_cast<const char *>(data), readSize))];
+				const auto duplicate = std::find_if(candidates.begin(), candidates.end(), [&](size_t row)
+				{
+					if (readSizes[row] != readSize)
+						return false;
+
+					const auto candidate = AcquireBlock(row, i);
+					return candidate && std::memcmp(candidate->Data(), data, readSize) == 0;
+				});
+				if (duplicate != candidates.end())
+				{
+					dataOffsets[j][i] = dataOffsets[*duplicate][i];
+					report.duplicateBlocks++;
+					report.bytesSaved += readSize;
+					continue;
+				}
+				candidates.push_back(j);
+			}
+
+			dataOffsets[j][i] = static_cast<uint32_t>(blockSize);
+			writtenRows[i].push_back(j);
+			blockSize = AlignOffset(blockSize + readSize, (i != 0 && j != lastRow) ? 0x80 : 16);
+		}
+	}
+
+
 	// ID BLOCK
+	trace.Next("IDBlock");
 	writer.VisitAndWrite<uint32_t>(idBlockPointerPos, writer.GetOffset());
-	auto entryDataPointerPos = std::vector<std::array<off_t, 3>>(m_entries.size());
-	auto entryIter = m_entries.begin();
-	for (auto i = 0U; i < m_entries.size(); i++)
-	{
-		writer.Write<uint64_t>(entryIter->first);
 
-		const auto &e = entryIter->second;
+	const auto lowWord = bigEndian ? 1 : 0;
+	const auto dependencyCountShift = bigEndian ? 16 : 0;
+
+	auto records = std::vector<IDBlockRecord>(numEntries);
+	for (auto i = 0U; i < numEntries; i++)
+	{
+		auto &record = records[i];
 
-		writer.Write<uint64_t>(e.info.checksum);
+		record.resourceID[lowWord] = m_entries.resourceIDs[i];
+		record.resourceID[1 - lowWord] = 0;
+		record.checksum[lowWord] = m_entries.checksums[i];
+		record.checksum[1 - lowWord] = 0;
 
-		for (auto &dataInfo : e.fileBlockData)
-			writer.Write(dataInfo.uncompressedSize | (BitScanReverse(dataInfo.uncompressedAlignment) << 28));
-		for (auto &dataInfo : e.fileBlockData)
-			writer.Write(dataInfo.compressedSize);
 		for (auto j = 0; j < 3; j++)
 		{
-			entryDataPointerPos[i][j] = writer.GetOffset();
-			writer.Seek(4, std::ios::cur);
+			const auto uncompressedAlignment = m_entries.uncompressedAlignments[j][i];
+			const auto alignment = uncompressedAlignment > 1 ? static_cast<uint32_t>(BitScanReverse(uncompressedAlignment)) : 0;
+			record.uncompressedSizes[j] = m_entries.uncompressedSizes[j][i] | (alignment << 28);
+			record.compressedSizes[j] = m_entries.compressedSizes[j][i];
+			record.dataOffsets[j] = dataOffsets[i][j];
 		}
 
-		writer.Write(e.info.dependenciesOffset);
-		writer.Write(e.info.resourceType);
-		writer.Write(e.info.numberOfDependencies);
-
-		writer.Seek(2, std::ios::cur); // padding
-
-		entryIter = std::next(entryIter);
+		record.dependenciesOffset = m_entries.dependenciesOffsets[i];
+		record.resourceType = m_entries.resourceTypes[i];
+		record.numberOfDependencies = static_cast<uint32_t>(m_entries.numberOfDependencies[i]) << dependencyCountShift;
 	}
 
+	const auto idBlockSize = records.size() * sizeof(IDBlockRecord);
+	if (bigEndian)
+		ByteSwap32Array(reinterpret_cast<uint32_t *>(records.data()), idBlockSize / sizeof(uint32_t));
+	writer.Write(reinterpret_cast<const char *>(records.data()), idBlockSize);
+
 	// DATA BLOCK
+	trace.Next("Data");
 	for (auto i = 0; i < 3; i++)
 	{
 		const auto blockStart = writer.GetOffset();
 		writer.VisitAndWrite<uint32_t>(fileBlockPointerPos[i], blockStart);
 
-		entryIter = m_entries.begin();
-		for (auto j = 0U; j < m_entries.size(); j++)
+		const auto &readSizes = (m_flags & Compressed) ? m_entries.compressedSizes[i] : m_entries.uncompressedSizes[i];
+		for (const auto j : writtenRows[i])
 		{
-			const auto &e = entryIter->second;
-
-			const auto &dataInfo = e.fileBlockData[i];
-			const auto readSize = (m_flags & Compressed) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
-
-			if (readSize > 0)
-			{
-				writer.VisitAndWrite<uint32_t>(entryDataPointerPos[j][i], writer.GetOffset() - blockStart);
-				writer.Write(dataInfo.data->data(), readSize);
-				writer.Align((i != 0 && j != m_entries.size() - 1) ? 0x80 : 16);
-			}
-
-			entryIter = std::next(entryIter);
+			assert(writer.GetOffset() - blockStart == dataOffsets[j][i]);
+			const auto block = AcquireBlock(j, i);
+			if (!block)
+				return false;
+			writer.Write(reinterpret_cast<const char *>(block->Data()), readSizes[j]);
+			writer.Align((i != 0 && j != lastRow) ? 0x80 : 16);
 		}
 
 		if (i != 2)
@@ -496,15 +802,33 @@ bool Bundle::SaveBND2(binaryio::BinaryWriter &writer)
 bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 {
 	writer.SetBigEndian(true);
+	TraceScope trace(m_traceSink, "Header");
 
 	writer.Write("bndl", 4);
 	writer.Write<uint32_t>(5); // TODO: sometimes this is 3 or 4?
 
 	const bool writeDebugData = !m_debugInfoEntries.empty() && (m_flags & Compressed) == 0; // TODO: is the compressed check accurate?
-	uint32_t entryCount = m_entries.size();
+	auto entryCount = static_cast<uint32_t>(m_entries.Size());
 	if (writeDebugData)
 		entryCount++;
 
+	// Read released blocks back up front, so nothing can fail once the debug data row has been added.
+	std::vector<BlockStorage> blocks[2];
+	for (auto i = 0U; i < 2; i++)
+	{
+		blocks[i].resize(m_entries.Size());
+		for (size_t row = 0; row < m_entries.Size(); row++)
+		{
+			if (!m_entries.blockData[i][row].HasData())
+				continue;
+
+			auto block = AcquireBlock(row, i);
+			if (!block)
+				return false;
+			blocks[i][row] = std::move(*block);
+		}
+	}
+
 	writer.Write<uint32_t>(entryCount);
 
 	off_t dataBlockDescriptorsPos[2];
@@ -543,15 +867,17 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 	writer.Write<uint32_t>(0); // Graphics memory alignment.
 
 	// ID LIST
+	trace.Next("IDList");
 	writer.VisitAndWrite<uint32_t>(idListPointerPos, writer.GetOffset());
-	for (const auto &entry : m_entries)
+	for (const auto resourceID : m_entries.resourceIDs)
 	{
-		writer.Write<uint64_t>(entry.first);
+		writer.Write<uint64_t>(resourceID);
 	}
 	if (writeDebugData)
 		writer.Write<uint64_t>(0xC039284A);
 
 	// Prepare ResourceStringTable
+	trace.Next("ResourceStringTable");
 	if (writeDebugData)
 	{
 		pugi::xml_document doc;
@@ -578,14 +904,19 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 
 		const auto data = debugDataWriter.GetStream().str();
 
-		auto &e = m_entries[0xFFFFFFFF]; // HACK
-		e.info.resourceType = TextFile;
-		e.fileBlockData[0].data = std::make_unique<std::vector<uint8_t>>(data.begin(), data.end());
-		e.fileBlockData[0].uncompressedSize = data.size();
-		e.fileBlockData[0].uncompressedAlignment = 4;
+		const auto row = m_entries.Insert(0xFFFFFFFF); // HACK
+		m_entries.resourceTypes[row] = TextFile;
+		m_entries.blockData[0][row] = { std::make_shared<const std::vector<uint8_t>>(data.begin(), data.end()), 0 };
+		m_entries.uncompressedSizes[0][row] = static_cast<uint32_t>(data.size());
+		m_entries.uncompressedAlignments[0][row] = 4;
+
+		assert(row == blocks[0].size());
+		blocks[0].push_back(m_entries.blockData[0][row]);
+		blocks[1].emplace_back();
 	}
 
 	// ID TABLE
+	trace.Next("IDTable");
 	writer.VisitAndWrite<uint32_t>(idTablePointerPos, writer.GetOffset());
 
 	struct FilePointerPosHelper
@@ -593,17 +924,17 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 		off_t importPointerPos;
 		off_t dataBlockPointerPos[2];
 	};
-	std::map<uint32_t, FilePointerPosHelper> filePointerPosMap;
-	for (const auto &entry : m_entries)
+	std::vector<FilePointerPosHelper> filePointerPos(m_entries.Size());
+	for (auto row = 0U; row < m_entries.Size(); row++)
 	{
 		writer.Write<uint32_t>(0); // Ignore
 
-		auto &posHelper = filePointerPosMap[entry.first];
+		auto &posHelper = filePointerPos[row];
 
 		posHelper.importPointerPos = writer.GetOffset();
 		writer.Write<uint32_t>(0);
 
-		writer.Write(entry.second.info.resourceType);
+		writer.Write(m_entries.resourceTypes[row]);
 
 		for (auto i = 0; i < 5; i++)
 		{
@@ -618,10 +949,9 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 			}
 			else
 			{
-				const auto &blockData = entry.second.fileBlockData[mappedBlock];
-				const auto size = (m_flags & Compressed) ? blockData.compressedSize : blockData.uncompressedSize;
+				const auto size = (m_flags & Compressed) ? m_entries.compressedSizes[mappedBlock][row] : m_entries.uncompressedSizes[mappedBlock][row];
 				writer.Write<uint32_t>(size);
-				writer.Write<uint32_t>((size == 0) ? 1 : blockData.uncompressedAlignment);
+				writer.Write<uint32_t>((size == 0) ? 1 : m_entries.uncompressedAlignments[mappedBlock][row]);
 			}
 		}
 
@@ -645,7 +975,7 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 	if (m_flags & Compressed)
 	{
 		writer.VisitAndWrite<uint32_t>(uncompInfoBlockPointerPos, writer.GetOffset());
-		for (const auto &entry : m_entries)
+		for (auto row = 0U; row < m_entries.Size(); row++)
 		{
 			for (auto i = 0; i < 5; i++)
 			{
@@ -660,25 +990,27 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 				}
 				else
 				{
-					const auto &blockData = entry.second.fileBlockData[mappedBlock];
-					writer.Write<uint32_t>(blockData.uncompressedSize);
-					writer.Write<uint32_t>((blockData.uncompressedSize == 0) ? 1 : blockData.uncompressedAlignment);
+					const auto uncompressedSize = m_entries.uncompressedSizes[mappedBlock][row];
+					writer.Write<uint32_t>(uncompressedSize);
+					writer.Write<uint32_t>((uncompressedSize == 0) ? 1 : m_entries.uncompressedAlignments[mappedBlock][row]);
 				}
 			}
 		}
 	}
 
 	// IMPORTS
+	trace.Next("Imports");
 	writer.VisitAndWrite<uint32_t>(importBlockPointerPos, writer.GetOffset());
-	for (const auto &entry : m_entries)
+	for (auto row = 0U; row < m_entries.Size(); row++)
 	{
-		const auto &imports = m_dependencies[entry.first];
-		if (imports.empty())
+		const auto importsIt = m_dependencies.find(m_entries.resourceIDs[row]);
+		if (importsIt == m_dependencies.end() || importsIt->second.empty())
 			continue;
+		const auto &imports = importsIt->second;
 
-		writer.VisitAndWrite<uint32_t>(filePointerPosMap.at(entry.first).importPointerPos, writer.GetOffset());
+		writer.VisitAndWrite<uint32_t>(filePointerPos[row].importPointerPos, writer.GetOffset());
 
-		writer.Write<uint32_t>(imports.size());
+		writer.Write<uint32_t>(static_cast<uint32_t>(imports.size()));
 		writer.Write<uint32_t>(0); // unknown, always seems to be 0
 		for (const auto &import : imports)
 		{
@@ -689,36 +1021,36 @@ bool Bundle::SaveBNDL(binaryio::BinaryWriter &writer)
 	}
 
 	// DATA
+	trace.Next("Data");
 	writer.VisitAndWrite<uint32_t>(dataBlockPointerPos, writer.GetOffset());
 	off_t blockStartOffset = 0;
 	for (auto i = 0; i < 2; i++)
 	{
-		for (const auto &entry : m_entries)
+		const auto &readSizes = (m_flags & Compressed) ? m_entries.compressedSizes[i] : m_entries.uncompressedSizes[i];
+		for (auto row = 0U; row < m_entries.Size(); row++)
 		{
-			const auto &e = entry.second;
-
-			const auto &dataInfo = e.fileBlockData[i];
-			const auto readSize = (m_flags & Compressed) ? dataInfo.compressedSize : dataInfo.uncompressedSize;
+			const auto readSize = readSizes[row];
 
 			if (readSize > 0)
 			{
-				writer.VisitAndWrite<uint32_t>(filePointerPosMap.at(entry.first).dataBlockPointerPos[i], writer.GetOffset() - blockStartOffset);
-				writer.Write(dataInfo.data->data(), readSize);
+				writer.VisitAndWrite<uint32_t>(filePointerPos[row].dataBlockPointerPos[i], writer.GetOffset() - blockStartOffset);
+				writer.Write(reinterpret_cast<const char *>(blocks[i][row].Data()), readSize);
 			}
 		}
 
 		const auto size = writer.GetOffset() - blockStartOffset;
 		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i], size);
-		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i], (size == 0) ? 1 : ((i == 1) ? 4096 : 1024)); // TODO: This changes and I don't know the pattern.
+		writer.VisitAndWrite<uint32_t>(dataBlockDescriptorsPos[i] + 4, (size == 0) ? 1 : ((i == 1) ? 4096 : 1024)); // TODO: This changes and I don't know the pattern.
 		blockStartOffset = writer.GetOffset();
 	}
 
-	m_entries.erase(0xFFFFFFFF);
+	if (writeDebugData)
+		m_entries.Erase(*m_entries.Find(0xFFFFFFFF));
 
 	return true;
 }
 
-uint32_t Bundle::HashResourceName(std::string resourceName) const
+uint32_t Bundle::HashResourceName(std::string resourceName)
 {
 	std::transform(resourceName.begin(), resourceName.end(), resourceName.begin(), tolower);
 	return crc32_z(0, reinterpret_cast<const Bytef *>(resourceName.c_str()), resourceName.length());
@@ -741,18 +1073,18 @@ std::optional<Bundle::EntryData> Bundle::GetData(const std::string &resourceName
 
 std::optional<Bundle::EntryData> Bundle::GetData(uint32_t resourceID) const
 {
-	const auto it = m_entries.find(resourceID);
-	if (it == m_entries.end())
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
 		return {};
 
 	EntryData data;
 	for (auto i = 0; i < 3; i++)
 	{
 		data.fileBlockData[i] = GetBinary(resourceID, i);
-		data.alignments[i] = it->second.fileBlockData[i].uncompressedAlignment;
+		data.alignments[i] = m_entries.uncompressedAlignments[i][*row];
 	}
 
-	const auto numDependencies = it->second.info.numberOfDependencies;
+	const auto numDependencies = m_entries.numberOfDependencies[*row];
 	if (numDependencies > 0)
 	{
 		if (m_magicVersion == BNDL)
@@ -761,11 +1093,16 @@ std::optional<Bundle::EntryData> Bundle::GetData(uint32_t resourceID) const
 		}
 		else
 		{
-			const auto buffer = std::make_shared<std::vector<uint8_t>>(data.fileBlockData[0]->begin() + it->second.info.dependenciesOffset, data.fileBlockData[0]->end());
-			binaryio::BinaryReader reader(buffer, m_platform != PC);
-			for (auto i = 0U; i < numDependencies; i++)
-				data.dependencies.emplace_back(ReadDependency(reader));
-			data.fileBlockData[0]->resize(data.fileBlockData[0]->size() - buffer->size());
+			if (data.fileBlockData[0] == nullptr)
+				return {};
+
+			auto &block = *data.fileBlockData[0];
+			const auto dependenciesOffset = m_entries.dependenciesOffsets[*row];
+			if (dependenciesOffset > block.size() || (block.size() - dependenciesOffset) / sizeof(DependencyRecord) < numDependencies)
+				return {};
+
+			data.dependencies = ReadDependencies(block.data() + dependenciesOffset, numDependencies, m_platform != PC);
+			block.resize(dependenciesOffset);
 		}
 	}
 
@@ -779,36 +1116,266 @@ std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinary(const std::string &resou
 
 std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinary(uint32_t resourceID, uint32_t fileBlock) const
 {
-	const auto it = m_entries.find(resourceID);
-	if (it == m_entries.end())
+	const auto row = m_entries.Find(resourceID);
+	if (!row || fileBlock >= 3)
 		return {};
 
-	const auto &e = it->second;
+	if (!m_entries.blockData[fileBlock][*row].HasData())
+		return {};
 
-	const auto &dataInfo = e.fileBlockData[fileBlock];
+	TraceScope trace(m_traceSink, "GetBinary", resourceID);
+	auto uncompressedBuffer = std::make_unique<std::vector<uint8_t>>(m_entries.uncompressedSizes[fileBlock][*row]);
 
-	if (dataInfo.data == nullptr)
+	if (!ReadBlock(*row, fileBlock, uncompressedBuffer->data(), true))
 		return {};
 
-	const auto &buffer = dataInfo.data;
-	const auto uncompressedSize = dataInfo.uncompressedSize;
+	return uncompressedBuffer;
+}
 
-	auto uncompressedBuffer = std::make_unique<std::vector<uint8_t>>(uncompressedSize);
+bool Bundle::ReadBinary(const std::string &resourceName, uint32_t fileBlock, uint8_t *buffer, size_t size) const
+{
+	return ReadBinary(HashResourceName(resourceName), fileBlock, buffer, size);
+}
 
-	if (m_flags & Compressed)
+bool Bundle::ReadBinary(uint32_t resourceID, uint32_t fileBlock, uint8_t *buffer, size_t size) const
+{
+	const auto row = m_entries.Find(resourceID);
+	if (!row || fileBlock >= 3 || !m_entries.blockData[fileBlock][*row].HasData())
+		return false;
+
+	if (size < m_entries.uncompressedSizes[fileBlock][*row])
+		return false;
+
+	return ReadBlock(*row, fileBlock, buffer, false);
+}
+
+std::optional<Bundle::AlignedBuffer> Bundle::GetAlignedBinary(const std::string &resourceName, uint32_t fileBlock, bool allowHugePages) const
+{
+	return GetAlignedBinary(HashResourceName(resourceName), fileBlock, allowHugePages);
+}
+
+std::optional<Bundle::AlignedBuffer> Bundle::GetAlignedBinary(uint32_t resourceID, uint32_t fileBlock, bool allowHugePages) const
+{
+	const auto row = m_entries.Find(resourceID);
+	if (!row || fileBlock >= 3 || !m_entries.blockData[fileBlock][*row].HasData())
+		return {};
+
+	const auto uncompressedSize = m_entries.uncompressedSizes[fileBlock][*row];
+	AlignedBuffer buffer(uncompressedSize, m_entries.uncompressedAlignments[fileBlock][*row], allowHugePages);
+	if (buffer.data() == nullptr || !ReadBlock(*row, fileBlock, buffer.data(), true))
+		return {};
+
+	return buffer;
+}
+
+bool Bundle::ReadBlock(size_t row, uint32_t fileBlock, uint8_t *buffer, bool allocated) const
+{
+	const auto &block = m_entries.blockData[fileBlock][row];
+	if (!block.HasData())
+		return false;
+
+	const auto uncompressedSize = m_entries.uncompressedSizes[fileBlock][row];
+	const auto compressed = (m_flags & Compressed) != 0;
+	const auto resourceID = m_entries.resourceIDs[row];
+	if (m_accessRecorder)
+		m_accessRecorder->Record(resourceID);
+
+	// The key says where the block is in the file, so only blocks that still match it can be cached.
+	const auto cached = compressed && m_diskCache && m_sourceFile && block.fileOffset != BlockStorage::NotInFile;
+	const auto cacheKey = cached ? DiskCache::Key{ m_sourceFile->key, resourceID, fileBlock, block.fileOffset } : DiskCache::Key();
+
+	// Each step is traced and timed on its own, so cached and uncached runs compare like for like.
+	auto ok = true;
+	auto cacheHit = false;
+	uint64_t inflateNanoseconds = 0;
+	if (cached)
 	{
-		uLongf uncompressedSizeLong = uncompressedSize;
-		const auto ret = uncompress(uncompressedBuffer->data(), &uncompressedSizeLong, buffer->data(), static_cast<uLong>(dataInfo.compressedSize));
+		TraceScope trace(m_traceSink, "ReadCache", resourceID);
+		cacheHit = m_diskCache->Read(cacheKey, buffer, uncompressedSize);
+	}
+
+	if (!cacheHit)
+	{
+		const auto stored = AcquireBlock(row, fileBlock);
+		if (!stored)
+		{
+			ok = false;
+		}
+		else if (compressed)
+		{
+			{
+				TraceScope trace(m_traceSink, "Inflate", resourceID);
+				const auto start = m_statistics ? StatisticsCollector::Clock::now() : StatisticsCollector::Clock::time_point();
+				uLongf uncompressedSizeLong = uncompressedSize;
+				const auto ret = uncompress(buffer, &uncompressedSizeLong, stored->Data(), static_cast<uLong>(m_entries.compressedSizes[fileBlock][row]));
+				if (m_statistics)
+					inflateNanoseconds = StatisticsCollector::NanosecondsSince(start);
+
+				ok = ret == Z_OK && uncompressedSize == uncompressedSizeLong;
+			}
+
+			if (ok && cached)
+			{
+				TraceScope trace(m_traceSink, "WriteCache", resourceID);
+				m_diskCache->Write(cacheKey, buffer, uncompressedSize);
+			}
+		}
+		else
+		{
+			TraceScope trace(m_traceSink, "Copy", resourceID);
+			std::memcpy(buffer, stored->Data(), uncompressedSize);
+		}
+	}
 
-		assert(ret == Z_OK);
-		assert(uncompressedSize == uncompressedSizeLong);
+	if (m_statistics)
+	{
+		Statistics::Counters counters = {};
+		counters.bytesRead = compressed && !cacheHit ? m_entries.compressedSizes[fileBlock][row] : uncompressedSize;
+		if (cached)
+		{
+			counters.cacheHits = cacheHit;
+			counters.cacheMisses = !cacheHit;
+		}
+		if (compressed && !cacheHit)
+		{
+			counters.bytesInflated = uncompressedSize;
+			counters.inflateNanoseconds = inflateNanoseconds;
+		}
+		if (allocated)
+		{
+			counters.allocations = 1;
+			counters.allocatedBytes = uncompressedSize;
+		}
+		m_statistics->Record(m_entries.resourceTypes[row], counters);
 	}
-	else
+
+	return ok;
+}
+
+std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinaryPrefix(const std::string &resourceName, uint32_t fileBlock, size_t size) const
+{
+	return GetBinaryPrefix(HashResourceName(resourceName), fileBlock, size);
+}
+
+std::unique_ptr<std::vector<uint8_t>> Bundle::GetBinaryPrefix(uint32_t resourceID, uint32_t fileBlock, size_t size) const
+{
+	auto reader = OpenBinary(resourceID, fileBlock);
+	if (!reader)
+		return {};
+
+	auto prefix = std::make_unique<std::vector<uint8_t>>(std::min(size, reader->GetSize()));
+	if (m_statistics)
 	{
-		std::memcpy(uncompressedBuffer->data(), buffer->data(), uncompressedSize);
+		Statistics::Counters counters = {};
+		counters.allocations = 1;
+		counters.allocatedBytes = prefix->size();
+		m_statistics->Record(*GetResourceType(resourceID), counters);
 	}
+	if (reader->Read(prefix->data(), prefix->size()) != prefix->size())
+		return {};
 
-	return uncompressedBuffer;
+	return prefix;
+}
+
+std::optional<Bundle::BlockReader> Bundle::OpenBinary(const std::string &resourceName, uint32_t fileBlock) const
+{
+	return OpenBinary(HashResourceName(resourceName), fileBlock);
+}
+
+std::optional<Bundle::BlockReader> Bundle::OpenBinary(uint32_t resourceID, uint32_t fileBlock) const
+{
+	const auto row = m_entries.Find(resourceID);
+	if (!row || fileBlock >= 3)
+		return {};
+
+	auto reader = OpenBlock(*row, fileBlock);
+	if (reader && m_accessRecorder)
+		m_accessRecorder->Record(resourceID);
+
+	return reader;
+}
+
+std::optional<Bundle::BlockReader> Bundle::OpenBlock(size_t row, uint32_t fileBlock) const
+{
+	const auto block = AcquireBlock(row, fileBlock);
+	if (!block)
+		return {};
+
+	const auto compressed = (m_flags & Compressed) != 0;
+	const auto uncompressedSize = m_entries.uncompressedSizes[fileBlock][row];
+	const auto storedSize = compressed ? m_entries.compressedSizes[fileBlock][row] : uncompressedSize;
+
+	return BlockReader(block->buffer, block->Data(), storedSize, uncompressedSize, compressed, m_statistics, m_entries.resourceTypes[row]);
+}
+
+std::optional<std::vector<Bundle::Dependency>> Bundle::ReadEntryDependencies(size_t row) const
+{
+	const auto numDependencies = m_entries.numberOfDependencies[row];
+	if (numDependencies == 0)
+		return std::vector<Dependency>();
+
+	if (m_magicVersion == BNDL)
+	{
+		const auto it = m_dependencies.find(m_entries.resourceIDs[row]);
+		if (it == m_dependencies.end())
+			return {};
+		return it->second;
+	}
+
+	// Only inflate as far as the end of the table.
+	auto reader = OpenBlock(row, 0);
+	if (!reader)
+		return {};
+
+	const auto tableEnd = static_cast<size_t>(m_entries.dependenciesOffsets[row]) + numDependencies * sizeof(DependencyRecord);
+	if (tableEnd > reader->GetSize())
+		return {};
+
+	std::vector<uint8_t> prefix(tableEnd);
+	if (reader->Read(prefix.data(), prefix.size()) != prefix.size())
+		return {};
+
+	return ReadDependencies(prefix.data() + m_entries.dependenciesOffsets[row], numDependencies, m_platform != PC);
+}
+
+std::vector<uint32_t> Bundle::GetDependencyOrder(const std::vector<uint32_t> &roots) const
+{
+	std::vector<uint32_t> order;
+	std::vector<bool> visited(m_entries.Size());
+	std::vector<size_t> stack;
+
+	for (const auto root : roots)
+	{
+		const auto row = m_entries.Find(root);
+		if (!row)
+			continue;
+
+		stack.push_back(*row);
+		while (!stack.empty())
+		{
+			const auto current = stack.back();
+			stack.pop_back();
+			if (visited[current])
+				continue;
+
+			visited[current] = true;
+			order.push_back(m_entries.resourceIDs[current]);
+
+			const auto dependencies = ReadEntryDependencies(current);
+			if (!dependencies)
+				continue;
+
+			// Pushed in reverse so the first dependency is visited next.
+			for (auto dependency = dependencies->rbegin(); dependency != dependencies->rend(); ++dependency)
+			{
+				const auto dependencyRow = m_entries.Find(dependency->resourceID);
+				if (dependencyRow && !visited[*dependencyRow])
+					stack.push_back(*dependencyRow);
+			}
+		}
+	}
+
+	return order;
 }
 
 std::optional<Bundle::EntryDebugInfo> Bundle::GetDebugInfo(const std::string &resourceName) const
@@ -832,11 +1399,11 @@ std::optional<Bundle::ResourceType> Bundle::GetResourceType(const std::string &r
 
 std::optional<Bundle::ResourceType> Bundle::GetResourceType(uint32_t resourceID) const
 {
-	const auto it = m_entries.find(resourceID);
-	if (it == m_entries.end())
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
 		return {};
 
-	return it->second.info.resourceType;
+	return m_entries.resourceTypes[*row];
 }
 
 bool Bundle::AddResource(const std::string &resourceName, const EntryData &data, Bundle::ResourceType resourceType)
@@ -846,14 +1413,39 @@ bool Bundle::AddResource(const std::string &resourceName, const EntryData &data,
 
 bool Bundle::AddResource(uint32_t resourceID, const EntryData &data, Bundle::ResourceType resourceType)
 {
-	const auto it = m_entries.find(resourceID);
-	if (it != m_entries.end() || data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+	TraceScope trace(m_traceSink, "AddResource", resourceID);
+
+	if (m_entries.Find(resourceID))
+		return false;
+
+	EncodedEntry encoded;
+	if (!EncodeEntry(data, nullptr, encoded))
+		return false;
+
+	InsertEntry(resourceID, resourceType, std::move(encoded));
+
+	return true;
+}
+
+bool Bundle::AddResource(const std::string &resourceName, EntryData &&data, Bundle::ResourceType resourceType)
+{
+	return AddResource(HashResourceName(resourceName), std::move(data), resourceType);
+}
+
+bool Bundle::AddResource(uint32_t resourceID, EntryData &&data, Bundle::ResourceType resourceType)
+{
+	TraceScope trace(m_traceSink, "AddResource", resourceID);
+
+	if (m_entries.Find(resourceID))
+		return false;
+
+	EncodedEntry encoded;
+	if (!EncodeEntry(data, data.fileBlockData, encoded))
 		return false;
 
-	Entry &e = m_entries[resourceID];
-	e.info.resourceType = resourceType;
+	InsertEntry(resourceID, resourceType, std::move(encoded));
 
-	return ReplaceResource(resourceID, data);
+	return true;
 }
 
 bool Bundle::AddDebugInfo(const std::string &resourceName, const std::string &name, const std::string &type)
@@ -881,113 +1473,429 @@ bool Bundle::ReplaceResource(const std::string &resourceName, const EntryData &d
 
 bool Bundle::ReplaceResource(uint32_t resourceID, const EntryData &data)
 {
-	const auto it = m_entries.find(resourceID);
-	if (it == m_entries.end() || data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+	TraceScope trace(m_traceSink, "ReplaceResource", resourceID);
+
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
+		return false;
+
+	EncodedEntry encoded;
+	if (!EncodeEntry(data, nullptr, encoded))
+		return false;
+
+	StoreEntry(*row, std::move(encoded));
+
+	return true;
+}
+
+bool Bundle::ReplaceResource(const std::string &resourceName, EntryData &&data)
+{
+	return ReplaceResource(HashResourceName(resourceName), std::move(data));
+}
+
+bool Bundle::ReplaceResource(uint32_t resourceID, EntryData &&data)
+{
+	TraceScope trace(m_traceSink, "ReplaceResource", resourceID);
+
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
+		return false;
+
+	EncodedEntry encoded;
+	if (!EncodeEntry(data, data.fileBlockData, encoded))
 		return false;
 
-	Entry &e = it->second;
+	StoreEntry(*row, std::move(encoded));
 
-	e.info.checksum = 0;
-	e.info.dependenciesOffset = 0;
-	e.info.numberOfDependencies = 0;
+	return true;
+}
+
+bool Bundle::RemoveResource(const std::string &resourceName)
+{
+	return RemoveResource(HashResourceName(resourceName));
+}
+
+bool Bundle::RemoveResource(uint32_t resourceID)
+{
+	TraceScope trace(m_traceSink, "RemoveResource", resourceID);
 
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
+		return false;
+
+	const auto typeIndex = m_resourceIDsByType.find(m_entries.resourceTypes[*row]);
+	auto &resourceIDs = typeIndex->second;
+	resourceIDs.erase(std::lower_bound(resourceIDs.begin(), resourceIDs.end(), resourceID));
+	if (resourceIDs.empty())
+		m_resourceIDsByType.erase(typeIndex);
+
+	m_entries.Erase(*row);
+	m_dependencies.erase(resourceID);
+	m_debugInfoEntries.erase(resourceID);
+
+	return true;
+}
+
+bool Bundle::EncodeEntry(const EntryData &data, std::unique_ptr<std::vector<uint8_t>> *ownedBlocks, EncodedEntry &encoded) const
+{
+	if (data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+		return false;
+
+	// BND2 keeps the dependency table in block 0, so it can't hold dependencies without data.
+	const auto hasData = [&data](int i) { return data.fileBlockData[i] != nullptr && !data.fileBlockData[i]->empty(); };
+	if (m_magicVersion == BND2 && !data.dependencies.empty() && !hasData(0))
+		return false;
+
+	// Check every block before taking over any of the caller's buffers, so a rejected entry is left as it was.
+	std::vector<uint8_t> dependencyTables[3];
+	size_t dataSizes[3] = {};
 	for (auto i = 0; i < 3; i++)
 	{
-		const auto &inDataInfo = data.fileBlockData[i];
-		auto &outDataInfo = e.fileBlockData[i];
+		if (!hasData(i))
+			continue;
 
-		if (inDataInfo == nullptr || inDataInfo->empty())
+		dataSizes[i] = BuildDependencyTable(data, i, dependencyTables[i]);
+		if (dataSizes[i] + dependencyTables[i].size() > ~(0xFU << 28)) // The high nibble holds the alignment.
+			return false;
+	}
+
+	encoded.dependenciesOffset = 0;
+	encoded.numberOfDependencies = static_cast<uint16_t>(data.dependencies.size());
+	if (m_magicVersion == BNDL)
+		encoded.dependencies = data.dependencies;
+
+	for (auto i = 0; i < 3; i++)
+	{
+		const auto &input = data.fileBlockData[i];
+
+		encoded.uncompressedAlignments[i] = data.alignments[i];
+		encoded.compressedSizes[i] = 0;
+
+		if (!hasData(i))
 		{
-			outDataInfo.data = nullptr;
-			outDataInfo.uncompressedSize = 0;
-			outDataInfo.compressedSize = 0;
+			encoded.blockData[i] = {};
+			encoded.uncompressedSizes[i] = 0;
 			continue;
 		}
 
-		std::unique_ptr<std::vector<uint8_t>> inBuffer;
-		std::unique_ptr<std::vector<uint8_t>> outBuffer;
+		const auto &dependencyTable = dependencyTables[i];
+		const auto dataSize = dataSizes[i];
+		if (!dependencyTable.empty())
+			encoded.dependenciesOffset = static_cast<uint32_t>(dataSize);
 
-		if (m_magicVersion == BND2 && i == 0 && !data.dependencies.empty())
+		const auto uncompressedSize = dataSize + dependencyTable.size();
+		encoded.uncompressedSizes[i] = static_cast<uint32_t>(uncompressedSize);
+
+		if (m_flags & Compressed)
 		{
-			binaryio::BinaryWriter writer;
-			for (const auto &dependency : data.dependencies)
+			auto outBuffer = std::make_shared<std::vector<uint8_t>>();
+			if (!DeflateBlock(*input, dataSize, dependencyTable, *outBuffer, encoded.counters))
 			{
-				WriteDependency(writer, dependency);
-				e.info.checksum &= dependency.resourceID;
+				assert(0);
+				return false;
 			}
-			const auto depSize = writer.GetSize();
-			auto depStream = writer.GetStream();
 
-			const auto inSize = inDataInfo->size();
-			binaryio::Align(inSize, 16);
-			inBuffer = std::make_unique<std::vector<uint8_t>>(inSize + depSize);
-			inBuffer->assign(inDataInfo->begin(), inDataInfo->end());
-			inBuffer->resize(inSize);
-			inBuffer->insert(inBuffer->end(), std::istreambuf_iterator<char>(depStream), std::istreambuf_iterator<char>());
+			encoded.compressedSizes[i] = static_cast<uint32_t>(outBuffer->size());
+			encoded.blockData[i] = { std::move(outBuffer), 0 };
+			continue;
+		}
 
-			e.info.dependenciesOffset = static_cast<uint32_t>(inSize);
-			e.info.numberOfDependencies = static_cast<uint16_t>(data.dependencies.size());
+		std::shared_ptr<std::vector<uint8_t>> outBuffer;
+		if (ownedBlocks != nullptr)
+		{
+			// Take over the caller's buffer, growing it in place for the dependency table.
+			outBuffer = std::move(ownedBlocks[i]);
+			outBuffer->resize(dataSize);
 		}
 		else
 		{
-			inBuffer = std::make_unique<std::vector<uint8_t>>(inDataInfo->begin(), inDataInfo->end());
+			outBuffer = std::make_shared<std::vector<uint8_t>>();
+			outBuffer->reserve(uncompressedSize);
+			outBuffer->assign(input->begin(), input->end());
+			outBuffer->resize(dataSize);
+			encoded.counters.allocations++;
+			encoded.counters.allocatedBytes += uncompressedSize;
 		}
+		outBuffer->insert(outBuffer->end(), dependencyTable.begin(), dependencyTable.end());
 
-		const auto uncompressedSize = static_cast<uint32_t>(inBuffer->size());
+		encoded.blockData[i] = { std::move(outBuffer), 0 };
+	}
 
-		if (m_flags & Compressed)
+	return true;
+}
+
+size_t Bundle::BuildDependencyTable(const EntryData &data, uint32_t fileBlock, std::vector<uint8_t> &dependencyTable) const
+{
+	// BND2 keeps the dependency table at the end of the first block.
+	const auto inputSize = data.fileBlockData[fileBlock]->size();
+	if (m_magicVersion != BND2 || fileBlock != 0 || data.dependencies.empty())
+		return inputSize;
+
+	dependencyTable.resize(data.dependencies.size() * sizeof(DependencyRecord));
+	WriteDependencies(dependencyTable.data(), data.dependencies, m_platform != PC);
+
+	return AlignOffset(inputSize, 16);
+}
+
+bool Bundle::DeflateBlock(const std::vector<uint8_t> &input, size_t dataSize, const std::vector<uint8_t> &dependencyTable, std::vector<uint8_t> &out, Statistics::Counters &counters) const
+{
+	// Deflate straight from the input so it never needs to be copied.
+	static const uint8_t padding[16] = {};
+	TraceScope trace(m_traceSink, "Deflate");
+	const auto start = m_statistics ? StatisticsCollector::Clock::now() : StatisticsCollector::Clock::time_point();
+
+	if (!Deflate({ { input.data(), input.size() }, { padding, dataSize - input.size() }, { dependencyTable.data(), dependencyTable.size() } }, m_compressionLevel, out))
+		return false;
+
+	if (m_statistics)
+	{
+		counters.bytesDeflated += dataSize + dependencyTable.size();
+		counters.deflateNanoseconds += StatisticsCollector::NanosecondsSince(start);
+		counters.allocations++;
+		counters.allocatedBytes += out.capacity();
+	}
+
+	return true;
+}
+
+std::optional<Bundle::CompressedEntryData> Bundle::CompressResource(const EntryData &data) const
+{
+	if (data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+		return {};
+
+	CompressedEntryData compressed;
+	compressed.dependencies = data.dependencies;
+	compressed.dependenciesOffset = 0;
+
+	Statistics::Counters counters = {};
+	for (auto i = 0U; i < 3; i++)
+	{
+		const auto &input = data.fileBlockData[i];
+
+		compressed.alignments[i] = data.alignments[i];
+		compressed.uncompressedSizes[i] = 0;
+		if (input == nullptr || input->empty())
+			continue;
+
+		std::vector<uint8_t> dependencyTable;
+		const auto dataSize = BuildDependencyTable(data, i, dependencyTable);
+		if (!dependencyTable.empty())
+			compressed.dependenciesOffset = static_cast<uint32_t>(dataSize);
+
+		const auto uncompressedSize = dataSize + dependencyTable.size();
+		if (uncompressedSize > ~(0xFU << 28)) // The high nibble holds the alignment.
+			return {};
+		compressed.uncompressedSizes[i] = static_cast<uint32_t>(uncompressedSize);
+
+		compressed.fileBlockData[i] = std::make_unique<std::vector<uint8_t>>();
+		if (!DeflateBlock(*input, dataSize, dependencyTable, *compressed.fileBlockData[i], counters))
+			return {};
+	}
+
+	if (m_statistics)
+		m_statistics->Record(counters);
+
+	return compressed;
+}
+
+bool Bundle::AddCompressedResource(const std::string &resourceName, CompressedEntryData &&data, ResourceType resourceType, bool verify)
+{
+	return AddCompressedResource(HashResourceName(resourceName), std::move(data), resourceType, verify);
+}
+
+bool Bundle::AddCompressedResource(uint32_t resourceID, CompressedEntryData &&data, ResourceType resourceType, bool verify)
+{
+	TraceScope trace(m_traceSink, "AddCompressedResource", resourceID);
+
+	if (m_entries.Find(resourceID))
+		return false;
+
+	EncodedEntry encoded;
+	if (!EncodeCompressedEntry(std::move(data), verify, encoded))
+		return false;
+
+	InsertEntry(resourceID, resourceType, std::move(encoded));
+
+	return true;
+}
+
+bool Bundle::ReplaceCompressedResource(const std::string &resourceName, CompressedEntryData &&data, bool verify)
+{
+	return ReplaceCompressedResource(HashResourceName(resourceName), std::move(data), verify);
+}
+
+bool Bundle::ReplaceCompressedResource(uint32_t resourceID, CompressedEntryData &&data, bool verify)
+{
+	TraceScope trace(m_traceSink, "ReplaceCompressedResource", resourceID);
+
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
+		return false;
+
+	EncodedEntry encoded;
+	if (!EncodeCompressedEntry(std::move(data), verify, encoded))
+		return false;
+
+	StoreEntry(*row, std::move(encoded));
+
+	return true;
+}
+
+bool Bundle::EncodeCompressedEntry(CompressedEntryData &&data, bool verify, EncodedEntry &encoded) const
+{
+	if (data.dependencies.size() > std::numeric_limits<uint16_t>::max())
+		return false;
+
+	const auto embeddedDependencies = m_magicVersion == BND2 && !data.dependencies.empty();
+	if (embeddedDependencies && (data.dependenciesOffset > data.uncompressedSizes[0]
+		|| (data.uncompressedSizes[0] - data.dependenciesOffset) / sizeof(DependencyRecord) < data.dependencies.size()))
+		return false;
+
+	encoded.dependenciesOffset = embeddedDependencies ? data.dependenciesOffset : 0;
+	encoded.numberOfDependencies = static_cast<uint16_t>(data.dependencies.size());
+	if (m_magicVersion == BNDL)
+		encoded.dependencies = std::move(data.dependencies);
+
+	for (auto i = 0; i < 3; i++)
+	{
+		auto &input = data.fileBlockData[i];
+		const auto uncompressedSize = data.uncompressedSizes[i];
+
+		encoded.uncompressedAlignments[i] = data.alignments[i];
+		encoded.compressedSizes[i] = 0;
+
+		if (input == nullptr || input->empty())
 		{
-			const auto compBufferSize = compressBound(static_cast<uLong>(inBuffer->size()));
-			outBuffer = std::make_unique<std::vector<uint8_t>>(compBufferSize);
-			uLongf actualSize = compBufferSize;
-			const auto ret = compress2(outBuffer->data(), &actualSize, inBuffer->data(), static_cast<uLong>(inBuffer->size()), Z_BEST_COMPRESSION);
+			if (uncompressedSize != 0)
+				return false;
 
-			if (ret != Z_OK)
+			encoded.blockData[i] = {};
+			encoded.uncompressedSizes[i] = 0;
+			continue;
+		}
+
+		if (uncompressedSize == 0 || uncompressedSize > ~(0xFU << 28)) // The high nibble holds the alignment.
+			return false;
+		encoded.uncompressedSizes[i] = uncompressedSize;
+
+		if (m_flags & Compressed)
+		{
+			if (verify)
 			{
-				assert(0);
-				return false;
+				// Leave room for one byte past the end so short blocks have to reach the end of the stream.
+				std::vector<uint8_t> sample(std::min<size_t>(uncompressedSize + 1, 0x1000));
+				auto sampleSize = sample.size();
+				const auto start = m_statistics ? StatisticsCollector::Clock::now() : StatisticsCollector::Clock::time_point();
+				const auto ret = InflatePrefix(input->data(), input->size(), sample.data(), sampleSize);
+				if (m_statistics)
+				{
+					encoded.counters.bytesInflated += sampleSize;
+					encoded.counters.inflateNanoseconds += StatisticsCollector::NanosecondsSince(start);
+				}
+				const auto ended = ret == Z_STREAM_END && sampleSize == uncompressedSize;
+				const auto continues = ret == Z_OK && sampleSize == sample.size() && sampleSize <= uncompressedSize;
+				if (!ended && !continues)
+					return false;
 			}
 
-			outBuffer->shrink_to_fit();
-			outDataInfo.compressedSize = actualSize;
+			encoded.compressedSizes[i] = static_cast<uint32_t>(input->size());
+			encoded.blockData[i] = { std::move(input), 0 };
 		}
 		else
 		{
-			outBuffer = std::move(inBuffer);
-			outDataInfo.compressedSize = 0;
-		}
+			const auto start = m_statistics ? StatisticsCollector::Clock::now() : StatisticsCollector::Clock::time_point();
+			auto outBuffer = std::make_shared<std::vector<uint8_t>>(uncompressedSize);
+			auto outSize = static_cast<uLongf>(uncompressedSize);
+			const auto ret = uncompress(outBuffer->data(), &outSize, input->data(), static_cast<uLong>(input->size()));
+			if (ret != Z_OK || outSize != uncompressedSize)
+				return false;
+
+			if (m_statistics)
+			{
+				encoded.counters.bytesRead += input->size();
+				encoded.counters.bytesInflated += uncompressedSize;
+				encoded.counters.inflateNanoseconds += StatisticsCollector::NanosecondsSince(start);
+				encoded.counters.allocations++;
+				encoded.counters.allocatedBytes += uncompressedSize;
+			}
 
-		outDataInfo.uncompressedSize = uncompressedSize;
-		outDataInfo.data = std::move(outBuffer);
-		outDataInfo.uncompressedAlignment = data.alignments[i];
+			encoded.blockData[i] = { std::move(outBuffer), 0 };
+		}
 	}
 
 	return true;
 }
 
-void Bundle::WriteDependency(binaryio::BinaryWriter &writer, const Dependency &dependency)
+void Bundle::StoreEntry(size_t row, EncodedEntry &&encoded)
 {
-	writer.Write<uint64_t>(dependency.resourceID);
-	writer.Write(dependency.internalOffset);
-	writer.Align(8);
+	// GetData can't find the dependencies of a BND2 entry without its table.
+	assert(m_magicVersion != BND2 || encoded.numberOfDependencies == 0 || encoded.dependenciesOffset != 0);
+
+	m_entries.checksums[row] = 0;
+	m_entries.dependenciesOffsets[row] = encoded.dependenciesOffset;
+	m_entries.numberOfDependencies[row] = encoded.numberOfDependencies;
+	for (auto i = 0; i < 3; i++)
+	{
+		m_entries.uncompressedSizes[i][row] = encoded.uncompressedSizes[i];
+		m_entries.uncompressedAlignments[i][row] = encoded.uncompressedAlignments[i];
+		m_entries.compressedSizes[i][row] = encoded.compressedSizes[i];
+		m_entries.blockData[i][row] = std::move(encoded.blockData[i]);
+	}
+
+	const auto resourceID = m_entries.resourceIDs[row];
+	if (encoded.dependencies.empty())
+		m_dependencies.erase(resourceID);
+	else
+		m_dependencies[resourceID] = std::move(encoded.dependencies);
+
+	if (m_statistics)
+		m_statistics->Record(m_entries.resourceTypes[row], encoded.counters);
+}
+
+void Bundle::InsertEntry(uint32_t resourceID, ResourceType resourceType, EncodedEntry &&encoded)
+{
+	const auto row = m_entries.Insert(resourceID);
+	m_entries.resourceTypes[row] = resourceType;
+
+	auto &typeIndex = m_resourceIDsByType[resourceType];
+	typeIndex.insert(std::lower_bound(typeIndex.begin(), typeIndex.end(), resourceID), resourceID);
+
+	StoreEntry(row, std::move(encoded));
 }
 
 std::vector<uint32_t> Bundle::ListResourceIDs() const
 {
-	std::vector<uint32_t> entries;
-	for (const auto &e : m_entries)
+	return m_entries.resourceIDs;
+}
+
+Bundle::SizeTotals Bundle::GetSizeTotals() const
+{
+	SizeTotals totals = {};
+	totals.resourceCount = static_cast<uint32_t>(m_entries.Size());
+	for (auto i = 0; i < 3; i++)
 	{
-		entries.push_back(e.first);
+		for (const auto size : m_entries.uncompressedSizes[i])
+			totals.uncompressedSize[i] += size;
+		for (const auto size : m_entries.compressedSizes[i])
+			totals.compressedSize[i] += size;
 	}
-	return entries;
+	return totals;
 }
 
-std::map<Bundle::ResourceType, std::vector<uint32_t>> Bundle::ListResourceIDsByType() const
+Bundle::SizeTotals Bundle::GetSizeTotals(ResourceType resourceType) const
 {
-	std::map<ResourceType, std::vector<uint32_t>> entriesByResourceType;
-	for (const auto &e : m_entries)
+	SizeTotals totals = {};
+	const auto &resourceTypes = m_entries.resourceTypes;
+	for (auto row = 0U; row < resourceTypes.size(); row++)
 	{
-		entriesByResourceType[e.second.info.resourceType].push_back(e.first);
+		// Branchless so the loop stays a straight column scan.
+		const uint64_t match = resourceTypes[row] == resourceType;
+		totals.resourceCount += static_cast<uint32_t>(match);
+		for (auto i = 0; i < 3; i++)
+		{
+			totals.uncompressedSize[i] += match * m_entries.uncompressedSizes[i][row];
+			totals.compressedSize[i] += match * m_entries.compressedSizes[i][row];
+		}
 	}
-	return entriesByResourceType;
+	return totals;
 }
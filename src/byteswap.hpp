@@ -0,0 +1,63 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+#if defined(_MSC_VER)
+#	include <stdlib.h>
+#endif
+
+#if defined(__SSSE3__)
+#	include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define LIBBNDL_BYTESWAP_SSE2
+#elif defined(__ARM_NEON)
+#	include <arm_neon.h>
+#endif
+
+namespace libbndl
+{
+	inline uint32_t ByteSwap32(uint32_t input)
+	{
+#if defined(_MSC_VER)
+		return _byteswap_ulong(input);
+#elif defined(__GNUC__)
+		return __builtin_bswap32(input);
+#else
+		return (input << 24) | (input << 8 & 0xff0000) | (input >> 8 & 0xff00) | (input >> 24);
+#endif
+	}
+
+	// Swaps the byte order of every 32-bit word in the array, 16 bytes at a time where possible.
+	inline void ByteSwap32Array(uint32_t *data, size_t count)
+	{
+		size_t i = 0;
+
+#if defined(__SSSE3__)
+		const auto mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+		for (; i + 4 <= count; i += 4)
+		{
+			const auto words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), _mm_shuffle_epi8(words, mask));
+		}
+#elif defined(LIBBNDL_BYTESWAP_SSE2)
+		for (; i + 4 <= count; i += 4)
+		{
+			auto words = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+			words = _mm_or_si128(_mm_slli_epi16(words, 8), _mm_srli_epi16(words, 8));
+			words = _mm_shufflelo_epi16(words, _MM_SHUFFLE(2, 3, 0, 1));
+			words = _mm_shufflehi_epi16(words, _MM_SHUFFLE(2, 3, 0, 1));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(data + i), words);
+		}
+#elif defined(__ARM_NEON)
+		for (; i + 4 <= count; i += 4)
+		{
+			const auto words = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
+			vst1q_u8(reinterpret_cast<uint8_t *>(data + i), vrev32q_u8(words));
+		}
+#endif
+
+		for (; i < count; i++)
+			data[i] = ByteSwap32(data[i]);
+	}
+}
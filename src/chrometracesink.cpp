@@ -0,0 +1,56 @@
+#include <libbndl/bundle.hpp>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace libbndl;
+
+Bundle::ChromeTraceSink::ChromeTraceSink(const std::string &path) : m_path(path)
+{
+}
+
+Bundle::ChromeTraceSink::~ChromeTraceSink()
+{
+	Flush();
+}
+
+void Bundle::ChromeTraceSink::Complete(const char *name, uint64_t startNanoseconds, uint64_t durationNanoseconds, std::optional<uint32_t> resourceID)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Viewers only need thread IDs to be distinct, and small ones are easier to read.
+	const auto thread = m_threads.try_emplace(std::this_thread::get_id(), static_cast<uint32_t>(m_threads.size() + 1)).first->second;
+	m_events.push_back({ name, startNanoseconds, durationNanoseconds, thread, resourceID });
+}
+
+bool Bundle::ChromeTraceSink::Flush()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	std::ofstream file(m_path, std::ios::out | std::ios::trunc);
+	if (file.fail())
+		return false;
+
+	// Timestamps are in microseconds; the fractional part keeps nanosecond precision.
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	file << std::fixed << std::setprecision(3);
+	for (auto i = 0U; i < m_events.size(); i++)
+	{
+		const auto &event = m_events[i];
+		if (i != 0)
+			file << ',';
+		file << "\n{\"name\":\"" << event.name << "\",\"cat\":\"libbndl\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << event.startNanoseconds / 1000.0 << ",\"dur\":" << event.durationNanoseconds / 1000.0;
+		if (event.resourceID)
+		{
+			std::ostringstream resourceID;
+			resourceID << std::hex << std::setw(8) << std::setfill('0') << *event.resourceID;
+			file << ",\"args\":{\"resourceID\":\"" << resourceID.str() << "\"}";
+		}
+		file << '}';
+	}
+	file << "\n]}\n";
+
+	return !file.fail();
+}
@@ -0,0 +1,180 @@
+#include "diskcache.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace libbndl;
+
+namespace
+{
+	uint64_t HashFNV1a(uint64_t hash, const void *data, size_t size)
+	{
+		const auto bytes = static_cast<const uint8_t *>(data);
+		for (auto i = 0U; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 0x100000001B3ULL;
+		}
+		return hash;
+	}
+
+	std::string Hex(uint64_t value, int width)
+	{
+		std::ostringstream stream;
+		stream << std::hex << std::setw(width) << std::setfill('0') << value;
+		return stream.str();
+	}
+}
+
+DiskCache::DiskCache(std::filesystem::path directory, uint64_t maxSize) : m_directory(std::move(directory)), m_maxSize(maxSize)
+{
+}
+
+std::filesystem::path DiskCache::GetPath(const Key &key) const
+{
+	return m_directory / Hex(key.file, 16) / (Hex(key.resourceID, 8) + '_' + std::to_string(key.fileBlock) + '_' + Hex(key.fileOffset, 8) + ".bin");
+}
+
+bool DiskCache::Read(const Key &key, uint8_t *buffer, size_t size)
+{
+	const auto path = GetPath(key);
+	std::ifstream stream(path, std::ios::in | std::ios::binary | std::ios::ate);
+	if (stream.fail() || static_cast<uint64_t>(stream.tellg()) != size)
+		return false;
+
+	stream.seekg(0, std::ios::beg);
+	stream.read(reinterpret_cast<char *>(buffer), size);
+	if (!stream)
+		return false;
+
+	// Eviction goes by modification time, so a hit counts as a use.
+	std::error_code error;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+	return true;
+}
+
+void DiskCache::Write(const Key &key, const uint8_t *data, size_t size)
+{
+	static std::atomic<uint32_t> writeCounter = 0;
+
+	const auto path = GetPath(key);
+	std::error_code error;
+	std::filesystem::create_directories(path.parent_path(), error);
+	if (error)
+		return;
+
+	// Readers must never see a partly written file.
+	auto temporaryPath = path;
+	temporaryPath += ".tmp" + Hex(std::hash<std::thread::id>()(std::this_thread::get_id()), 16) + Hex(writeCounter++, 8);
+	{
+		std::ofstream stream(temporaryPath, std::ios::out | std::ios::binary);
+		stream.write(reinterpret_cast<const char *>(data), size);
+		if (!stream)
+		{
+			stream.close();
+			std::filesystem::remove(temporaryPath, error);
+			return;
+		}
+	}
+
+	std::filesystem::rename(temporaryPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(temporaryPath, error);
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_size)
+	{
+		m_size = 0;
+		for (const auto &file : std::filesystem::recursive_directory_iterator(m_directory, error))
+		{
+			if (file.is_regular_file(error))
+				*m_size += file.file_size(error);
+		}
+	}
+	else
+	{
+		*m_size += size;
+	}
+
+	if (*m_size > m_maxSize)
+		Evict();
+}
+
+void DiskCache::Evict()
+{
+	struct CachedFile
+	{
+		std::filesystem::file_time_type lastUse;
+		uint64_t size;
+		std::filesystem::path path;
+	};
+
+	std::error_code error;
+	std::vector<CachedFile> files;
+	uint64_t total = 0;
+	for (const auto &file : std::filesystem::recursive_directory_iterator(m_directory, error))
+	{
+		if (!file.is_regular_file(error))
+			continue;
+
+		const auto size = file.file_size(error);
+		files.push_back({ file.last_write_time(error), size, file.path() });
+		total += size;
+	}
+
+	std::sort(files.begin(), files.end(), [](const CachedFile &a, const CachedFile &b)
+	{
+		return a.lastUse < b.lastUse;
+	});
+
+	// Going down to three quarters leaves room for a while before the next scan.
+	const auto target = m_maxSize / 4 * 3;
+	for (const auto &file : files)
+	{
+		if (total <= target)
+			break;
+
+		if (std::filesystem::remove(file.path, error))
+			total -= file.size;
+	}
+
+	m_size = total;
+}
+
+void Bundle::SetCacheDirectory(const std::string &directory, uint64_t maxSize)
+{
+	if (directory.empty())
+		m_diskCache.reset();
+	else
+		m_diskCache = std::make_shared<DiskCache>(directory, maxSize);
+}
+
+std::optional<Bundle::SourceFile> Bundle::DescribeSourceFile(const std::string &name, uint64_t size)
+{
+	std::error_code error;
+	auto path = std::filesystem::absolute(name, error);
+	if (error)
+		return {};
+
+	const auto modified = std::filesystem::last_write_time(path, error);
+	if (error)
+		return {};
+
+	SourceFile sourceFile;
+	sourceFile.path = path.string();
+	sourceFile.size = size;
+	sourceFile.modified = static_cast<int64_t>(modified.time_since_epoch().count());
+
+	sourceFile.key = HashFNV1a(0xCBF29CE484222325ULL, sourceFile.path.data(), sourceFile.path.size());
+	sourceFile.key = HashFNV1a(sourceFile.key, &sourceFile.size, sizeof(sourceFile.size));
+	sourceFile.key = HashFNV1a(sourceFile.key, &sourceFile.modified, sizeof(sourceFile.modified));
+
+	return sourceFile;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <filesystem>
+#include <mutex>
+
+namespace libbndl
+{
+	// Inflated blocks stored one raw file each, so they can be read back or mapped as they are.
+	// Several bundles and processes can share a directory; files are written aside and renamed into place.
+	class DiskCache
+	{
+	public:
+		struct Key
+		{
+			uint64_t file; // Bundle::SourceFile::key
+			uint32_t resourceID;
+			uint32_t fileBlock;
+			uint64_t fileOffset;
+		};
+
+		DiskCache(std::filesystem::path directory, uint64_t maxSize);
+
+		// Fails unless the cached block has exactly this size.
+		bool Read(const Key &key, uint8_t *buffer, size_t size);
+		void Write(const Key &key, const uint8_t *data, size_t size);
+
+	private:
+		std::filesystem::path GetPath(const Key &key) const;
+		// Drops the least recently used files until the cache is comfortably below its limit.
+		void Evict();
+
+		std::filesystem::path m_directory;
+		uint64_t m_maxSize;
+		std::mutex m_mutex;
+		std::optional<uint64_t> m_size; // Counted on the first write, then kept up to date
+	};
+}
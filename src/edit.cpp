@@ -0,0 +1,198 @@
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+#include <atomic>
+#include "trace.hpp"
+
+using namespace libbndl;
+
+Bundle::Edit Bundle::BeginEdit()
+{
+	return Edit(*this);
+}
+
+Bundle::Edit::Edit(Bundle &bundle) : m_bundle(&bundle)
+{
+}
+
+void Bundle::Edit::AddResource(const std::string &resourceName, EntryData &&data, ResourceType resourceType)
+{
+	AddResource(m_bundle->HashResourceName(resourceName), std::move(data), resourceType);
+}
+
+void Bundle::Edit::AddResource(uint32_t resourceID, EntryData &&data, ResourceType resourceType)
+{
+	m_operations.push_back({ Operation::Add, resourceID, resourceType, std::move(data), {} });
+}
+
+void Bundle::Edit::ReplaceResource(const std::string &resourceName, EntryData &&data)
+{
+	ReplaceResource(m_bundle->HashResourceName(resourceName), std::move(data));
+}
+
+void Bundle::Edit::ReplaceResource(uint32_t resourceID, EntryData &&data)
+{
+	m_operations.push_back({ Operation::Replace, resourceID, {}, std::move(data), {} });
+}
+
+void Bundle::Edit::RemoveResource(const std::string &resourceName)
+{
+	RemoveResource(m_bundle->HashResourceName(resourceName));
+}
+
+void Bundle::Edit::RemoveResource(uint32_t resourceID)
+{
+	m_operations.push_back({ Operation::Remove, resourceID, {}, {}, {} });
+}
+
+void Bundle::Edit::AddDebugInfo(const std::string &resourceName, const std::string &name, const std::string &type)
+{
+	AddDebugInfo(m_bundle->HashResourceName(resourceName), name, type);
+}
+
+void Bundle::Edit::AddDebugInfo(uint32_t resourceID, const std::string &name, const std::string &type)
+{
+	m_operations.push_back({ Operation::DebugInfo, resourceID, {}, {}, { name, type } });
+}
+
+bool Bundle::Edit::Commit(unsigned threads)
+{
+	auto &bundle = *m_bundle;
+	auto operations = std::move(m_operations);
+	m_operations.clear();
+	TraceScope trace(bundle.m_traceSink, "Commit");
+
+	// Where each touched resource ends up once every operation has run.
+	struct Outcome
+	{
+		bool existed;
+		bool present;
+		ResourceType resourceType;
+		Operation *data; // The add or replace whose data is stored, if any
+		bool debugInfoChanged;
+		std::optional<EntryDebugInfo> debugInfo;
+	};
+
+	std::map<uint32_t, Outcome> outcomes;
+	for (auto &operation : operations)
+	{
+		auto it = outcomes.find(operation.resourceID);
+		if (it == outcomes.end())
+		{
+			const auto row = bundle.m_entries.Find(operation.resourceID);
+			const auto resourceType = row ? bundle.m_entries.resourceTypes[*row] : operation.resourceType;
+			it = outcomes.emplace(operation.resourceID, Outcome{ row.has_value(), row.has_value(), resourceType, nullptr, false, {} }).first;
+		}
+		auto &outcome = it->second;
+
+		// The same rules as the single calls, applied to the state the earlier operations left behind.
+		switch (operation.kind)
+		{
+		case Operation::Add:
+			if (outcome.present)
+				return false;
+			outcome.present = true;
+			outcome.resourceType = operation.resourceType;
+			outcome.data = &operation;
+			break;
+
+		case Operation::Replace:
+			if (!outcome.present)
+				return false;
+			outcome.data = &operation;
+			break;
+
+		case Operation::Remove:
+			if (!outcome.present)
+				return false;
+			outcome.present = false;
+			outcome.data = nullptr;
+			outcome.debugInfoChanged = true;
+			outcome.debugInfo.reset();
+			break;
+
+		case Operation::DebugInfo:
+			if (outcome.debugInfoChanged ? outcome.debugInfo.has_value() : bundle.m_debugInfoEntries.count(operation.resourceID) > 0)
+				return false;
+			outcome.debugInfoChanged = true;
+			outcome.debugInfo = operation.debugInfo;
+			break;
+		}
+	}
+
+	// Only the data that survives to the end gets compressed.
+	trace.Next("Encode");
+	std::vector<std::pair<uint32_t, const Outcome *>> stores;
+	for (const auto &[resourceID, outcome] : outcomes)
+	{
+		if (outcome.present && outcome.data != nullptr)
+			stores.emplace_back(resourceID, &outcome);
+	}
+
+	std::vector<EncodedEntry> encoded(stores.size());
+	std::atomic<size_t> next = 0;
+	std::atomic<bool> failed = false;
+	const auto encode = [&bundle, &stores, &encoded, &next, &failed]
+	{
+		for (auto i = next++; i < stores.size() && !failed; i = next++)
+		{
+			auto &data = stores[i].second->data->data;
+			if (!bundle.EncodeEntry(data, data.fileBlockData, encoded[i]))
+				failed = true;
+		}
+	};
+
+	if (threads == 0)
+		threads = std::max(1U, std::thread::hardware_concurrency());
+	threads = static_cast<unsigned>(std::min<size_t>(threads, stores.size()));
+
+	std::vector<std::thread> workers;
+	for (auto i = 1U; i < threads; i++)
+		workers.emplace_back(encode);
+	encode();
+	for (auto &worker : workers)
+		worker.join();
+
+	if (failed)
+		return false;
+
+	// Nothing can fail from here on.
+	trace.Next("Apply");
+	std::vector<size_t> removedRows;
+	std::vector<uint32_t> addedResourceIDs;
+	for (const auto &[resourceID, outcome] : outcomes)
+	{
+		if (outcome.existed && !outcome.present)
+		{
+			removedRows.push_back(*bundle.m_entries.Find(resourceID));
+			bundle.m_dependencies.erase(resourceID);
+		}
+		else if (!outcome.existed && outcome.present)
+		{
+			addedResourceIDs.push_back(resourceID);
+		}
+	}
+	bundle.m_entries.EraseRows(removedRows);
+	bundle.m_entries.InsertRows(addedResourceIDs);
+
+	for (auto i = 0U; i < stores.size(); i++)
+	{
+		const auto row = *bundle.m_entries.Find(stores[i].first);
+		bundle.m_entries.resourceTypes[row] = stores[i].second->resourceType;
+		bundle.StoreEntry(row, std::move(encoded[i]));
+	}
+
+	for (const auto &[resourceID, outcome] : outcomes)
+	{
+		if (!outcome.debugInfoChanged)
+			continue;
+
+		if (outcome.debugInfo)
+			bundle.m_debugInfoEntries[resourceID] = *outcome.debugInfo;
+		else
+			bundle.m_debugInfoEntries.erase(resourceID);
+	}
+
+	bundle.RebuildTypeIndex();
+
+	return true;
+}
@@ -0,0 +1,143 @@
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+
+using namespace libbndl;
+
+template <typename Func>
+void Bundle::EntryTable::ForEachColumn(Func &&func)
+{
+	func(resourceIDs);
+	func(checksums);
+	func(resourceTypes);
+	func(dependenciesOffsets);
+	func(numberOfDependencies);
+	for (auto i = 0; i < 3; i++)
+	{
+		func(uncompressedSizes[i]);
+		func(uncompressedAlignments[i]);
+		func(compressedSizes[i]);
+		func(blockData[i]);
+	}
+}
+
+std::optional<size_t> Bundle::EntryTable::Find(uint32_t resourceID) const
+{
+	const auto it = std::lower_bound(resourceIDs.begin(), resourceIDs.end(), resourceID);
+	if (it == resourceIDs.end() || *it != resourceID)
+		return {};
+
+	return static_cast<size_t>(it - resourceIDs.begin());
+}
+
+size_t Bundle::EntryTable::Insert(uint32_t resourceID)
+{
+	// Bundles store their entries sorted, so appending is the common case.
+	size_t row = resourceIDs.size();
+	if (!resourceIDs.empty() && resourceIDs.back() >= resourceID)
+		row = std::lower_bound(resourceIDs.begin(), resourceIDs.end(), resourceID) - resourceIDs.begin();
+
+	ForEachColumn([row](auto &column)
+	{
+		column.emplace(column.begin() + row);
+	});
+	resourceIDs[row] = resourceID;
+
+	return row;
+}
+
+void Bundle::EntryTable::Erase(size_t row)
+{
+	ForEachColumn([row](auto &column)
+	{
+		column.erase(column.begin() + row);
+	});
+}
+
+void Bundle::EntryTable::EraseRows(const std::vector<size_t> &rows)
+{
+	if (rows.empty())
+		return;
+
+	ForEachColumn([&rows](auto &column)
+	{
+		auto next = rows.begin();
+		auto out = rows.front();
+		for (auto in = rows.front(); in < column.size(); in++)
+		{
+			if (next != rows.end() && *next == in)
+			{
+				++next;
+				continue;
+			}
+			column[out++] = std::move(column[in]);
+		}
+		column.erase(column.begin() + out, column.end());
+	});
+}
+
+std::vector<size_t> Bundle::EntryTable::InsertRows(const std::vector<uint32_t> &newResourceIDs)
+{
+	// Merge the new IDs into the sorted ones to find where every row ends up.
+	const auto oldSize = Size();
+	std::vector<size_t> oldRows(oldSize);
+	std::vector<size_t> newRows(newResourceIDs.size());
+	for (size_t i = 0, j = 0; i < oldSize || j < newResourceIDs.size();)
+	{
+		if (j == newResourceIDs.size() || (i < oldSize && resourceIDs[i] < newResourceIDs[j]))
+		{
+			oldRows[i] = i + j;
+			i++;
+		}
+		else
+		{
+			newRows[j] = i + j;
+			j++;
+		}
+	}
+
+	// Rows only move towards the end, so going backwards never overwrites one that hasn't moved yet.
+	ForEachColumn([&](auto &column)
+	{
+		column.resize(oldSize + newResourceIDs.size());
+		for (auto row = oldSize; row-- > 0;)
+		{
+			if (oldRows[row] != row)
+				column[oldRows[row]] = std::move(column[row]);
+		}
+		for (const auto row : newRows)
+			column[row] = {};
+	});
+
+	for (auto j = 0U; j < newResourceIDs.size(); j++)
+		resourceIDs[newRows[j]] = newResourceIDs[j];
+
+	return newRows;
+}
+
+size_t Bundle::EntryTable::GetMemoryUsage() const
+{
+	size_t bytes = 0;
+	// ForEachColumn only hands the columns out; nothing is changed here.
+	const_cast<EntryTable *>(this)->ForEachColumn([&bytes](const auto &column)
+	{
+		bytes += column.capacity() * sizeof(column[0]);
+	});
+
+	return bytes;
+}
+
+void Bundle::EntryTable::Clear()
+{
+	ForEachColumn([](auto &column)
+	{
+		column.clear();
+	});
+}
+
+void Bundle::EntryTable::Reserve(size_t size)
+{
+	ForEachColumn([size](auto &column)
+	{
+		column.reserve(size);
+	});
+}
@@ -0,0 +1,98 @@
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+
+using namespace libbndl;
+
+Bundle::EntryIterator::EntryIterator(const Bundle *bundle, const uint32_t *resourceID, const uint32_t *end)
+	: m_bundle(bundle), m_resourceID(resourceID), m_end(end), m_row(0), m_debugInfo(bundle->m_debugInfoEntries.begin())
+{
+	Sync();
+}
+
+void Bundle::EntryIterator::Sync()
+{
+	if (m_resourceID == m_end)
+		return;
+
+	// The IDs we walk, the entry table and the debug info are all sorted, so both cursors only ever move forward.
+	const auto &resourceIDs = m_bundle->m_entries.resourceIDs;
+	if (m_row >= resourceIDs.size() || resourceIDs[m_row] != *m_resourceID)
+		m_row = std::lower_bound(resourceIDs.begin() + m_row, resourceIDs.end(), *m_resourceID) - resourceIDs.begin();
+
+	const auto debugInfoEnd = m_bundle->m_debugInfoEntries.end();
+	while (m_debugInfo != debugInfoEnd && m_debugInfo->first < *m_resourceID)
+		++m_debugInfo;
+}
+
+Bundle::EntryView Bundle::EntryIterator::operator*() const
+{
+	const auto hasDebugInfo = m_debugInfo != m_bundle->m_debugInfoEntries.end() && m_debugInfo->first == *m_resourceID;
+	return m_bundle->MakeEntryView(m_row, hasDebugInfo ? &m_debugInfo->second : nullptr);
+}
+
+Bundle::EntryIterator &Bundle::EntryIterator::operator++()
+{
+	++m_resourceID;
+	if (m_resourceID != m_end)
+	{
+		m_row++;
+		Sync();
+	}
+	return *this;
+}
+
+Bundle::EntryView Bundle::MakeEntryView(size_t row, const EntryDebugInfo *debugInfo) const
+{
+	EntryView view;
+	view.resourceID = m_entries.resourceIDs[row];
+	view.resourceType = m_entries.resourceTypes[row];
+	for (auto i = 0; i < 3; i++)
+	{
+		view.uncompressedSize[i] = m_entries.uncompressedSizes[i][row];
+		view.uncompressedAlignment[i] = m_entries.uncompressedAlignments[i][row];
+		view.compressedSize[i] = m_entries.compressedSizes[i][row];
+	}
+	view.numberOfDependencies = m_entries.numberOfDependencies[row];
+	view.debugInfo = debugInfo;
+	return view;
+}
+
+Bundle::EntryRange Bundle::Entries() const
+{
+	const auto begin = m_entries.resourceIDs.data();
+	const auto end = begin + m_entries.Size();
+	return EntryRange(EntryIterator(this, begin, end), EntryIterator(this, end, end), m_entries.Size());
+}
+
+Bundle::EntryRange Bundle::Entries(ResourceType resourceType) const
+{
+	const auto it = m_resourceIDsByType.find(resourceType);
+	if (it == m_resourceIDsByType.end())
+		return EntryRange(EntryIterator(this, nullptr, nullptr), EntryIterator(this, nullptr, nullptr), 0);
+
+	const auto begin = it->second.data();
+	const auto end = begin + it->second.size();
+	return EntryRange(EntryIterator(this, begin, end), EntryIterator(this, end, end), it->second.size());
+}
+
+std::optional<Bundle::EntryView> Bundle::GetEntry(const std::string &resourceName) const
+{
+	return GetEntry(HashResourceName(resourceName));
+}
+
+std::optional<Bundle::EntryView> Bundle::GetEntry(uint32_t resourceID) const
+{
+	const auto row = m_entries.Find(resourceID);
+	if (!row)
+		return {};
+
+	const auto debugInfo = m_debugInfoEntries.find(resourceID);
+	return MakeEntryView(*row, debugInfo != m_debugInfoEntries.end() ? &debugInfo->second : nullptr);
+}
+
+void Bundle::RebuildTypeIndex()
+{
+	m_resourceIDsByType.clear();
+	for (auto row = 0U; row < m_entries.Size(); row++)
+		m_resourceIDsByType[m_entries.resourceTypes[row]].push_back(m_entries.resourceIDs[row]);
+}
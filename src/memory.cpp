@@ -0,0 +1,224 @@
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+#include "statistics.hpp"
+#include "trace.hpp"
+
+using namespace libbndl;
+
+namespace
+{
+	// Red-black tree nodes carry three pointers and a colour alongside the value.
+	template <typename Map>
+	uint64_t MapNodeBytes(const Map &map)
+	{
+		return map.size() * (sizeof(typename Map::value_type) + 4 * sizeof(void *));
+	}
+
+	// Short strings live inside the object and cost nothing extra.
+	uint64_t StringBytes(const std::string &string)
+	{
+		return string.capacity() > std::string().capacity() ? string.capacity() + 1 : 0;
+	}
+}
+
+Bundle::MemoryFootprint Bundle::GetMemoryFootprint() const
+{
+	MemoryFootprint footprint = {};
+
+	std::unordered_set<const std::vector<uint8_t> *> counted;
+	for (auto i = 0; i < 3; i++)
+	{
+		for (size_t row = 0; row < m_entries.Size(); row++)
+		{
+			const auto &block = m_entries.blockData[i][row];
+			if (block.buffer == nullptr)
+			{
+				if (block.fileOffset != BlockStorage::NotInFile)
+					footprint.releasedBlocks++;
+				continue;
+			}
+
+			footprint.payloadsByType[m_entries.resourceTypes[row]] += (m_flags & Compressed) ? m_entries.compressedSizes[i][row] : m_entries.uncompressedSizes[i][row];
+
+			if (!counted.insert(block.buffer.get()).second)
+				continue;
+
+			// Shared arena blocks sit at their file offset within the loaded file.
+			if (block.fileOffset != BlockStorage::NotInFile && block.offset == block.fileOffset)
+				footprint.fileBuffers += block.buffer->capacity();
+			else
+				footprint.blockBuffers += block.buffer->capacity();
+		}
+	}
+
+	footprint.entryTable = m_entries.GetMemoryUsage();
+
+	footprint.typeIndex = MapNodeBytes(m_resourceIDsByType);
+	for (const auto &type : m_resourceIDsByType)
+		footprint.typeIndex += type.second.capacity() * sizeof(uint32_t);
+
+	footprint.debugInfo = MapNodeBytes(m_debugInfoEntries);
+	for (const auto &entry : m_debugInfoEntries)
+		footprint.debugInfo += StringBytes(entry.second.name) + StringBytes(entry.second.typeName);
+
+	footprint.dependencies = MapNodeBytes(m_dependencies);
+	for (const auto &entry : m_dependencies)
+		footprint.dependencies += entry.second.capacity() * sizeof(Dependency);
+
+	footprint.total = footprint.fileBuffers + footprint.blockBuffers + footprint.entryTable + footprint.typeIndex + footprint.debugInfo + footprint.dependencies;
+
+	return footprint;
+}
+
+void Bundle::SetMemoryBudget(uint64_t bytes)
+{
+	m_memoryBudget = bytes;
+	EnforceMemoryBudget();
+}
+
+void Bundle::EnforceMemoryBudget()
+{
+	if (m_memoryBudget == 0 || !m_sourceFile)
+		return;
+
+	// Blocks share buffers, so one is only freed once every block using it lets go.
+	struct BufferUse
+	{
+		uint64_t size = 0;
+		bool inFile = true;
+		std::vector<std::pair<size_t, uint32_t>> blocks; // Row and file block
+	};
+	std::unordered_map<const std::vector<uint8_t> *, BufferUse> uses;
+	uint64_t resident = 0;
+	for (auto i = 0U; i < 3; i++)
+	{
+		for (size_t row = 0; row < m_entries.Size(); row++)
+		{
+			const auto &block = m_entries.blockData[i][row];
+			if (block.buffer == nullptr)
+				continue;
+
+			auto &use = uses[block.buffer.get()];
+			if (use.blocks.empty())
+			{
+				use.size = block.buffer->capacity();
+				resident += use.size;
+			}
+			use.inFile &= block.fileOffset != BlockStorage::NotInFile;
+			use.blocks.emplace_back(row, i);
+		}
+	}
+
+	if (resident <= m_memoryBudget)
+		return;
+
+	TraceScope trace(m_traceSink, "ReleaseBlocks");
+
+	// Edited blocks exist nowhere else and have to stay.
+	std::vector<BufferUse *> releasable;
+	for (auto &use : uses)
+	{
+		if (use.second.inFile)
+			releasable.push_back(&use.second);
+	}
+	std::sort(releasable.begin(), releasable.end(), [](const BufferUse *a, const BufferUse *b)
+	{
+		return a->size > b->size;
+	});
+
+	Statistics::Counters counters = {};
+	for (const auto use : releasable)
+	{
+		if (resident <= m_memoryBudget)
+			break;
+
+		resident -= use->size;
+		for (const auto &[row, fileBlock] : use->blocks)
+		{
+			auto &block = m_entries.blockData[fileBlock][row];
+			const auto storedSize = (m_flags & Compressed) ? m_entries.compressedSizes[fileBlock][row] : m_entries.uncompressedSizes[fileBlock][row];
+
+			// A shared file buffer is split up, keeping copies of as many of its blocks as still fit.
+			if (use->blocks.size() > 1 && resident + storedSize <= m_memoryBudget)
+			{
+				const auto data = block.Data();
+				block.buffer = std::make_shared<const std::vector<uint8_t>>(data, data + storedSize);
+				block.offset = 0;
+				resident += storedSize;
+				counters.allocations++;
+				counters.allocatedBytes += storedSize;
+			}
+			else
+			{
+				block.buffer.reset();
+			}
+		}
+	}
+
+	if (m_statistics && counters.allocations > 0)
+		m_statistics->Record(counters);
+}
+
+std::optional<Bundle::BlockStorage> Bundle::AcquireBlock(size_t row, uint32_t fileBlock) const
+{
+	const auto &block = m_entries.blockData[fileBlock][row];
+	if (block.buffer != nullptr)
+		return block;
+	if (block.fileOffset == BlockStorage::NotInFile || !m_sourceFile)
+		return {};
+
+	// The offsets are only good for the file as it was loaded.
+	std::error_code error;
+	const auto fileSize = std::filesystem::file_size(m_sourceFile->path, error);
+	if (error || fileSize != m_sourceFile->size)
+		return {};
+
+	const auto modified = std::filesystem::last_write_time(m_sourceFile->path, error);
+	if (error || static_cast<int64_t>(modified.time_since_epoch().count()) != m_sourceFile->modified)
+		return {};
+
+	const auto storedSize = (m_flags & Compressed) ? m_entries.compressedSizes[fileBlock][row] : m_entries.uncompressedSizes[fileBlock][row];
+	if (block.fileOffset > fileSize || fileSize - block.fileOffset < storedSize)
+		return {};
+
+	TraceScope trace(m_traceSink, "ReadReleasedBlock", m_entries.resourceIDs[row]);
+	auto buffer = std::make_shared<std::vector<uint8_t>>(storedSize);
+	std::ifstream file(m_sourceFile->path, std::ios::in | std::ios::binary);
+	file.seekg(static_cast<std::streamoff>(block.fileOffset));
+	if (!file.read(reinterpret_cast<char *>(buffer->data()), storedSize))
+		return {};
+
+	if (m_statistics)
+	{
+		Statistics::Counters counters = {};
+		counters.allocations = 1;
+		counters.allocatedBytes = storedSize;
+		m_statistics->Record(m_entries.resourceTypes[row], counters);
+	}
+
+	return BlockStorage{ std::move(buffer), 0, block.fileOffset };
+}
+
+bool Bundle::RestoreReleasedBlocks()
+{
+	for (auto i = 0U; i < 3; i++)
+	{
+		for (size_t row = 0; row < m_entries.Size(); row++)
+		{
+			auto &block = m_entries.blockData[i][row];
+			if (block.buffer != nullptr || block.fileOffset == BlockStorage::NotInFile)
+				continue;
+
+			auto restored = AcquireBlock(row, i);
+			if (!restored)
+				return false;
+			block = std::move(*restored);
+		}
+	}
+
+	return true;
+}
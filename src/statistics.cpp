@@ -0,0 +1,66 @@
+#include "statistics.hpp"
+
+using namespace libbndl;
+
+namespace
+{
+	void Accumulate(Bundle::Statistics::Counters &target, const Bundle::Statistics::Counters &counters)
+	{
+		target.bytesRead += counters.bytesRead;
+		target.bytesInflated += counters.bytesInflated;
+		target.bytesDeflated += counters.bytesDeflated;
+		target.inflateNanoseconds += counters.inflateNanoseconds;
+		target.deflateNanoseconds += counters.deflateNanoseconds;
+		target.allocations += counters.allocations;
+		target.allocatedBytes += counters.allocatedBytes;
+		target.cacheHits += counters.cacheHits;
+		target.cacheMisses += counters.cacheMisses;
+	}
+}
+
+void StatisticsCollector::Record(const Bundle::Statistics::Counters &counters)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Accumulate(m_statistics.total, counters);
+}
+
+void StatisticsCollector::Record(Bundle::ResourceType resourceType, const Bundle::Statistics::Counters &counters)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Accumulate(m_statistics.total, counters);
+	Accumulate(m_statistics.byType.try_emplace(resourceType, Bundle::Statistics::Counters{}).first->second, counters);
+}
+
+Bundle::Statistics StatisticsCollector::Snapshot() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void StatisticsCollector::Reset()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics = {};
+}
+
+void Bundle::EnableStatistics(bool enable)
+{
+	if (!enable)
+		m_statistics.reset();
+	else if (m_statistics == nullptr)
+		m_statistics = std::make_shared<StatisticsCollector>();
+}
+
+std::optional<Bundle::Statistics> Bundle::GetStatistics() const
+{
+	if (m_statistics == nullptr)
+		return {};
+
+	return m_statistics->Snapshot();
+}
+
+void Bundle::ResetStatistics()
+{
+	if (m_statistics != nullptr)
+		m_statistics->Reset();
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <chrono>
+#include <mutex>
+
+namespace libbndl
+{
+	// Held through a shared_ptr so readers that outlive a call can keep recording into it.
+	class StatisticsCollector
+	{
+	public:
+		using Clock = std::chrono::steady_clock;
+
+		static uint64_t NanosecondsSince(Clock::time_point start)
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+		}
+
+		void Record(const Bundle::Statistics::Counters &counters);
+		void Record(Bundle::ResourceType resourceType, const Bundle::Statistics::Counters &counters);
+		Bundle::Statistics Snapshot() const;
+		void Reset();
+
+	private:
+		mutable std::mutex m_mutex;
+		Bundle::Statistics m_statistics = {};
+	};
+}
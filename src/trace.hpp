@@ -0,0 +1,57 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <chrono>
+
+namespace libbndl
+{
+	// Reports the time between construction and destruction, or between calls to Next, to a trace sink.
+	class TraceScope
+	{
+	public:
+		TraceScope(const std::shared_ptr<Bundle::TraceSink> &sink, const char *name, std::optional<uint32_t> resourceID = {})
+			: m_sink(sink.get()), m_name(name), m_resourceID(resourceID)
+		{
+			if (m_sink)
+				m_start = Now();
+		}
+
+		TraceScope(const TraceScope &) = delete;
+		TraceScope &operator=(const TraceScope &) = delete;
+
+		~TraceScope()
+		{
+			if (m_sink)
+				m_sink->Complete(m_name, m_start, Now() - m_start, m_resourceID);
+		}
+
+		void End()
+		{
+			if (m_sink)
+				m_sink->Complete(m_name, m_start, Now() - m_start, m_resourceID);
+			m_sink = nullptr;
+		}
+
+		// Ends the current phase and starts the next one.
+		void Next(const char *name)
+		{
+			if (!m_sink)
+				return;
+
+			const auto now = Now();
+			m_sink->Complete(m_name, m_start, now - m_start, m_resourceID);
+			m_name = name;
+			m_start = now;
+		}
+
+	private:
+		static uint64_t Now()
+		{
+			return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+		}
+
+		Bundle::TraceSink *m_sink;
+		const char *m_name;
+		std::optional<uint32_t> m_resourceID;
+		uint64_t m_start = 0;
+	};
+}
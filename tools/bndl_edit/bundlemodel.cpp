@@ -0,0 +1,159 @@
+#include "bundlemodel.hpp"
+#include <algorithm>
+
+using namespace libbndl;
+
+BundleModel::BundleModel(QObject *parent) : QAbstractItemModel(parent)
+{
+}
+
+void BundleModel::SetBundle(const Bundle *bundle)
+{
+	beginResetModel();
+	m_bundle = bundle;
+	m_groups.clear();
+	if (m_bundle != nullptr)
+	{
+		for (const auto &[resourceType, resourceIDs] : m_bundle->ListResourceIDsByType())
+			m_groups.push_back({ resourceType, &resourceIDs, 0 });
+	}
+	endResetModel();
+}
+
+std::optional<uint32_t> BundleModel::GetResourceID(const QModelIndex &index) const
+{
+	if (!index.isValid() || index.internalId() == GroupID)
+		return {};
+
+	const auto &group = m_groups[index.internalId() - 1];
+	return (*group.resourceIDs)[index.row()];
+}
+
+const BundleModel::Group *BundleModel::GetGroup(const QModelIndex &index) const
+{
+	if (!index.isValid() || index.internalId() != GroupID || index.column() != 0)
+		return nullptr;
+
+	return &m_groups[index.row()];
+}
+
+QModelIndex BundleModel::index(int row, int column, const QModelIndex &parent) const
+{
+	if (!hasIndex(row, column, parent))
+		return QModelIndex();
+
+	if (!parent.isValid())
+		return createIndex(row, column, GroupID);
+
+	return createIndex(row, column, static_cast<quintptr>(parent.row()) + 1);
+}
+
+QModelIndex BundleModel::parent(const QModelIndex &child) const
+{
+	if (!child.isValid() || child.internalId() == GroupID)
+		return QModelIndex();
+
+	return createIndex(static_cast<int>(child.internalId() - 1), 0, GroupID);
+}
+
+int BundleModel::rowCount(const QModelIndex &parent) const
+{
+	if (!parent.isValid())
+		return static_cast<int>(m_groups.size());
+
+	const auto group = GetGroup(parent);
+	return group ? group->fetched : 0;
+}
+
+int BundleModel::columnCount(const QModelIndex &) const
+{
+	return ColumnCount;
+}
+
+bool BundleModel::hasChildren(const QModelIndex &parent) const
+{
+	if (!parent.isValid())
+		return !m_groups.empty();
+
+	const auto group = GetGroup(parent);
+	return group && !group->resourceIDs->empty();
+}
+
+bool BundleModel::canFetchMore(const QModelIndex &parent) const
+{
+	const auto group = GetGroup(parent);
+	return group && static_cast<size_t>(group->fetched) < group->resourceIDs->size();
+}
+
+void BundleModel::fetchMore(const QModelIndex &parent)
+{
+	if (!canFetchMore(parent))
+		return;
+
+	auto &group = m_groups[parent.row()];
+	const auto count = static_cast<int>(std::min<size_t>(FetchBatchSize, group.resourceIDs->size() - group.fetched));
+	beginInsertRows(parent, group.fetched, group.fetched + count - 1);
+	group.fetched += count;
+	endInsertRows();
+}
+
+QVariant BundleModel::data(const QModelIndex &index, int role) const
+{
+	if (!index.isValid() || m_bundle == nullptr)
+		return QVariant();
+
+	if (index.internalId() == GroupID)
+	{
+		const auto &group = m_groups[index.row()];
+		if (role == Qt::DisplayRole && index.column() == NameColumn)
+			return QString("%1 (%2)").arg(static_cast<uint>(group.resourceType), 8, 16, QChar('0')).arg(static_cast<qulonglong>(group.resourceIDs->size()));
+		return QVariant();
+	}
+
+	const auto resourceID = *GetResourceID(index);
+	if (role == Qt::UserRole)
+		return resourceID;
+	if (role != Qt::DisplayRole)
+		return QVariant();
+
+	const auto entry = m_bundle->GetEntry(resourceID);
+	if (!entry)
+		return QVariant();
+
+	switch (index.column())
+	{
+	case NameColumn:
+		if (entry->debugInfo)
+			return QString::fromStdString(entry->debugInfo->name);
+		return QString("%1").arg(resourceID, 8, 16, QChar('0'));
+
+	case TypeColumn:
+		if (entry->debugInfo)
+			return QString::fromStdString(entry->debugInfo->typeName);
+		return QString("%1").arg(static_cast<uint>(entry->resourceType), 8, 16, QChar('0'));
+
+	case SizeColumn:
+		return static_cast<qulonglong>(entry->uncompressedSize[0]) + entry->uncompressedSize[1] + entry->uncompressedSize[2];
+
+	default:
+		return QVariant();
+	}
+}
+
+QVariant BundleModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+	if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+		return QVariant();
+
+	switch (section)
+	{
+	case NameColumn:
+		return tr("Name");
+	case TypeColumn:
+		return tr("Type");
+	case SizeColumn:
+		return tr("Size");
+	default:
+		return QVariant();
+	}
+}
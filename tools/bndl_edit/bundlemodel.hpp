@@ -0,0 +1,56 @@
+#pragma once
+#include <QAbstractItemModel>
+#include <libbndl/bundle.hpp>
+#include <optional>
+#include <vector>
+
+// Resources grouped by type, read straight from the bundle's index. Rows are only created and
+// labelled when a view asks for them, so opening a bundle costs one entry per resource type.
+class BundleModel : public QAbstractItemModel
+{
+	Q_OBJECT
+
+public:
+	enum Column
+	{
+		NameColumn,
+		TypeColumn,
+		SizeColumn,
+		ColumnCount
+	};
+
+	explicit BundleModel(QObject *parent = nullptr);
+
+	// The bundle must outlive the model, or be replaced first. Call again after modifying it.
+	void SetBundle(const libbndl::Bundle *bundle);
+
+	// Empty for type groups.
+	std::optional<uint32_t> GetResourceID(const QModelIndex &index) const;
+
+	QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+	QModelIndex parent(const QModelIndex &child) const override;
+	int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+	int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+	bool hasChildren(const QModelIndex &parent = QModelIndex()) const override;
+	bool canFetchMore(const QModelIndex &parent) const override;
+	void fetchMore(const QModelIndex &parent) override;
+	QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+	QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+private:
+	struct Group
+	{
+		libbndl::Bundle::ResourceType resourceType;
+		const std::vector<uint32_t> *resourceIDs; // Owned by the bundle's type index
+		int fetched; // Rows the view has been told about so far
+	};
+
+	// Children carry their group's row + 1 as internal ID; groups carry 0.
+	static constexpr quintptr GroupID = 0;
+	static constexpr int FetchBatchSize = 1024;
+
+	const Group *GetGroup(const QModelIndex &index) const;
+
+	const libbndl::Bundle *m_bundle = nullptr;
+	std::vector<Group> m_groups;
+};
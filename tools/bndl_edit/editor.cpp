@@ -7,6 +7,31 @@
 #include <QSplitter>
 #include <QPixmap>
 #include <QMessageBox>
+#include <QFile>
+
+namespace
+{
+	// Shows the phases Load finishes in the status bar. Called on the loading thread.
+	class LoadProgressSink : public TraceSink
+	{
+	public:
+		explicit LoadProgressSink(QStatusBar *statusBar) : m_statusBar(statusBar)
+		{
+		}
+
+		void Complete(const char *name, uint64_t, uint64_t, std::optional<uint32_t>) override
+		{
+			const auto message = QObject::tr("Loading: %1 done").arg(QString::fromLatin1(name));
+			QMetaObject::invokeMethod(m_statusBar, [statusBar = m_statusBar, message]
+			{
+				statusBar->showMessage(message);
+			}, Qt::QueuedConnection);
+		}
+
+	private:
+		QStatusBar *m_statusBar;
+	};
+}
 
 Editor::Editor(QWidget* parent)
 {
@@ -27,9 +52,12 @@ Editor::Editor(QWidget* parent)
 	content->setLayout(m_content);
 
 	//TREEVIEW
-	m_model = new QStandardItemModel;
+	m_model = new BundleModel(this);
 	treeview->setSelectionMode(QAbstractItemView::SingleSelection);
+	treeview->setUniformRowHeights(true);
 	treeview->setModel(m_model);
+	m_preview = new PreviewLoader(m_archive, this);
+	connect(m_preview, &PreviewLoader::Ready, this, &Editor::previewReady);
 	
 	splitter->addWidget(treeview);
 	splitter->addWidget(content);
@@ -48,6 +76,12 @@ Editor::Editor(QWidget* parent)
 	QString message = tr("A context menu is available by right-clicking");
 	statusBar()->showMessage(message);
 
+	m_loadProgress = new QProgressBar;
+	m_loadProgress->setRange(0, 0); // Load doesn't know how far along it is, only which phase finished
+	m_loadProgress->setMaximumWidth(150);
+	m_loadProgress->hide();
+	statusBar()->addPermanentWidget(m_loadProgress);
+
 	setMinimumSize(900, 600);
 
 }
@@ -57,35 +91,83 @@ void Editor::treeChanged(const QItemSelection &selected, const QItemSelection &d
 	QModelIndexList indices = selected.indexes();
 	if (indices.size() > 0)
 	{
-		QVariant data = indices.front().data();
-		QString entry = data.toString();
-		QString extension = entry.split('.').back();
-		/*if(extension=="ini"||extension=="inc"||extension=="txt")
+		// Decoding happens on the preview loader's thread; scrolling past entries just supersedes the request.
+		m_previewResource = m_model->GetResourceID(indices.front());
+		if (!m_previewResource)
 		{
-			m_content->setCurrentWidget(m_texteditor);
-			std::string content = m_archive.GetText(entry.toStdString());
-			m_texteditor->setText(QString(content.c_str()));
+			m_preview->Cancel();
+			return;
 		}
-		else if(extension=="jpg"||extension=="tga"||extension=="dds"||extension=="png")
-		{
-			m_content->setCurrentWidget(m_imageviewer);
-			size_t size = 0;
-			uint8_t* content = m_archive.GetBinary(entry.toStdString(), size);
-			QPixmap pixmap;
-			bool result = pixmap.loadFromData(content, (uint)size);
-			m_imageviewer->setPixmap(pixmap);
-		}*/
+
+		m_content->setCurrentWidget(m_texteditor);
+		m_texteditor->setPlainText(tr("Decoding..."));
+		m_preview->Request(*m_previewResource);
 	}
 	
 }
 
+void Editor::previewReady(uint32_t resourceID, const QString &preview)
+{
+	if (m_previewResource != resourceID)
+		return;
+
+	m_texteditor->setPlainText(preview);
+}
+
 Editor::~Editor()
 {
+	if (m_loader)
+		m_loader->wait();
+	// The preview loader is deleted with the window's children, after m_archive is gone.
+	m_preview->Clear();
 }
 
 void Editor::Load(const std::string & archive)
 {
+	if (m_loader)
+		return;
+
+	openAct->setEnabled(false);
+	saveAct->setEnabled(false);
+	m_loadProgress->show();
+	statusBar()->showMessage(tr("Loading %1").arg(QString::fromStdString(archive)));
+
+	// Load into a separate bundle so the open one stays browsable until the new one is ready.
+	auto bundle = std::make_shared<Bundle>();
+	auto loaded = std::make_shared<bool>(false);
+	auto sink = std::make_shared<LoadProgressSink>(statusBar());
+	m_loader = QThread::create([bundle, loaded, sink, archive]
+	{
+		bundle->SetTraceSink(sink);
+		*loaded = bundle->Load(archive);
+		bundle->SetTraceSink(nullptr);
+	});
+
+	connect(m_loader, &QThread::finished, this, [this, bundle, loaded, archive]
+	{
+		m_loader->deleteLater();
+		m_loader = nullptr;
+		openAct->setEnabled(true);
+		saveAct->setEnabled(true);
+		m_loadProgress->hide();
+
+		if (!*loaded)
+		{
+			statusBar()->clearMessage();
+			QMessageBox messageBox;
+			messageBox.critical(0, "Error", "Could not load the bundle.");
+			return;
+		}
+
+		ReplaceArchive(std::move(*bundle));
+		m_undoHistory.clear();
+		m_redoHistory.clear();
+		UpdateHistoryActions();
+		m_path = QString::fromStdString(archive);
+		statusBar()->showMessage(tr("Loaded %1 resources").arg(static_cast<qulonglong>(m_archive.GetResourceCount())));
+	});
 
+	m_loader->start();
 }
 
 struct Directory
@@ -95,17 +177,42 @@ struct Directory
 
 void Editor::PopulateTree()
 {
-	//get root of the tree
-	m_model->clear();
-	QStandardItem *item = m_model->invisibleRootItem();
-	for (const auto &resourceID : m_archive.ListResourceIDs())
-	{
-		const auto info = m_archive.GetDebugInfo(resourceID);
-		const auto &name = info ? QString::fromStdString(info->name) : QString::number(resourceID, 16);
-		QStandardItem *child = new QStandardItem(name);
-		child->setData(QVariant(name));
-		item->appendRow(child);
-	}
+	m_model->SetBundle(&m_archive);
+}
+
+bool Editor::Modify(const std::function<bool(Bundle &)> &edit)
+{
+	auto edited = m_archive;
+	if (!edit(edited))
+		return false;
+
+	m_undoHistory.push_back(ReplaceArchive(std::move(edited)));
+	if (m_undoHistory.size() > MaxHistory)
+		m_undoHistory.erase(m_undoHistory.begin());
+	m_redoHistory.clear();
+	UpdateHistoryActions();
+
+	return true;
+}
+
+Bundle Editor::ReplaceArchive(Bundle &&bundle)
+{
+	// Nothing may be reading the current bundle while it's replaced.
+	m_preview->Clear();
+	m_previewResource.reset();
+	m_model->SetBundle(nullptr);
+
+	auto previous = std::move(m_archive);
+	m_archive = std::move(bundle);
+	PopulateTree();
+
+	return previous;
+}
+
+void Editor::UpdateHistoryActions()
+{
+	undoAct->setEnabled(!m_undoHistory.empty());
+	redoAct->setEnabled(!m_redoHistory.empty());
 }
 
 void Editor::createActions()
@@ -138,6 +245,9 @@ void Editor::createActions()
 	createAction(copyAct, QKeySequence::Copy, "&Copy", "Copy selection", &Editor::copy);
 	//PASTE
 	createAction(pasteAct, QKeySequence::Paste, "&Paste", "Paste clipboard", &Editor::paste);
+	//REPLACE
+	createAction(replaceAct, QKeySequence::Replace, "R&eplace...", "Replace the selected resource's main block with a file", &Editor::replace);
+	UpdateHistoryActions();
 	//ABOUT
 	aboutAct = new QAction(tr("&About"), this);
 	aboutAct->setStatusTip(tr("Info about this program"));
@@ -165,6 +275,7 @@ void Editor::createMenus()
 	editMenu->addAction(cutAct);
 	editMenu->addAction(copyAct);
 	editMenu->addAction(pasteAct);
+	editMenu->addAction(replaceAct);
 	editMenu->addSeparator();
 
 	helpMenu = menuBar()->addMenu(tr("&Help"));
@@ -179,6 +290,7 @@ void Editor::contextMenuEvent(QContextMenuEvent *event)
 	menu.addAction(cutAct);
 	menu.addAction(copyAct);
 	menu.addAction(pasteAct);
+	menu.addAction(replaceAct);
 	menu.exec(event->globalPos());
 }
 #endif // QT_NO_CONTEXTMENU
@@ -194,17 +306,8 @@ void Editor::open()
 
 	if (fileName == nullptr)
 		return;
-	
-	if (m_archive.Load(fileName.toStdString()))
-	{
-		m_path = fileName;
-		PopulateTree();
-	}
-	else
-	{
-		QMessageBox messageBox;
-		messageBox.critical(0, "Error", "Could not load the bundle.");
-	}
+
+	Load(fileName.toStdString());
 }
 
 void Editor::save()
@@ -224,10 +327,24 @@ void Editor::saveAs()
 
 void Editor::undo()
 {
+	if (m_undoHistory.empty() || m_loader)
+		return;
+
+	auto previous = std::move(m_undoHistory.back());
+	m_undoHistory.pop_back();
+	m_redoHistory.push_back(ReplaceArchive(std::move(previous)));
+	UpdateHistoryActions();
 }
 
 void Editor::redo()
 {
+	if (m_redoHistory.empty() || m_loader)
+		return;
+
+	auto next = std::move(m_redoHistory.back());
+	m_redoHistory.pop_back();
+	m_undoHistory.push_back(ReplaceArchive(std::move(next)));
+	UpdateHistoryActions();
 }
 
 void Editor::cut()
@@ -242,6 +359,41 @@ void Editor::paste()
 {
 }
 
+void Editor::replace()
+{
+	if (!m_previewResource || m_loader)
+		return;
+
+	const auto resourceID = *m_previewResource;
+	auto fileName = QFileDialog::getOpenFileName(this, tr("Replace Resource"));
+	if (fileName.isEmpty())
+		return;
+
+	QFile file(fileName);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		QMessageBox messageBox;
+		messageBox.critical(0, "Error", "Could not read the file.");
+		return;
+	}
+	const auto contents = file.readAll();
+
+	const auto replaced = Modify([resourceID, &contents](Bundle &bundle)
+	{
+		auto data = bundle.GetData(resourceID);
+		if (!data)
+			return false;
+
+		data->fileBlockData[0] = std::make_unique<std::vector<uint8_t>>(contents.begin(), contents.end());
+		return bundle.ReplaceResource(resourceID, std::move(*data));
+	});
+	if (!replaced)
+	{
+		QMessageBox messageBox;
+		messageBox.critical(0, "Error", "Could not replace the resource.");
+	}
+}
+
 void Editor::about()
 {
 }
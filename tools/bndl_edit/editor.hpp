@@ -2,13 +2,19 @@
 #include <QMainWindow>
 #include <QTreeView>
 #include <QAction>
-#include <QStandardItemModel>
 #include <QStackedLayout>
 #include <QLabel>
 #include <QTextEdit>
 #include <QOpenGLWidget>
 #include <QMediaPlayer>
+#include <QProgressBar>
+#include <QThread>
 #include <libbndl/bundle.hpp>
+#include "bundlemodel.hpp"
+#include "previewloader.hpp"
+#include <functional>
+#include <optional>
+#include <vector>
 
 using namespace libbndl;
 
@@ -27,6 +33,7 @@ protected:
 #endif // QT_NO_CONTEXTMENU
 private slots:
 	void treeChanged(const QItemSelection &selected, const QItemSelection &deselected);
+	void previewReady(uint32_t resourceID, const QString &preview);
 	void newFile();
 	void open();
 	void save();
@@ -36,6 +43,7 @@ private slots:
 	void cut();
 	void copy();
 	void paste();
+	void replace();
 	void about();
 	void aboutQt();
 	void quit();
@@ -58,10 +66,16 @@ private:
 	QAction *cutAct;
 	QAction *copyAct;
 	QAction *pasteAct;
+	QAction *replaceAct;
 	QAction *aboutAct;
 	QAction *aboutQtAct;
 private:
 	void PopulateTree();
+	// Applies an edit to a snapshot of the bundle, which becomes current if the edit succeeds.
+	bool Modify(const std::function<bool(Bundle &)> &edit);
+	// Swaps in another bundle and returns the one it replaced.
+	Bundle ReplaceArchive(Bundle &&bundle);
+	void UpdateHistoryActions();
 private:
 	QMediaPlayer* m_mediaplayer;
 	QVideoWidget* m_videowidget;
@@ -69,7 +83,15 @@ private:
 	QLabel* m_imageviewer;
 	QOpenGLWidget* m_modelviewer;
 	QStackedLayout* m_content;
-	QStandardItemModel* m_model;
+	BundleModel* m_model;
+	PreviewLoader* m_preview;
+	std::optional<uint32_t> m_previewResource; // Selected resource whose preview is wanted
+	QProgressBar* m_loadProgress;
+	QThread* m_loader = nullptr; // Set while a bundle loads in the background
+	// Bundle copies share their payloads, so each step costs about one entry table.
+	std::vector<Bundle> m_undoHistory;
+	std::vector<Bundle> m_redoHistory;
+	static constexpr size_t MaxHistory = 100;
 	QString m_path;
 	Bundle m_archive;
 };
\ No newline at end of file
@@ -17,6 +17,8 @@ int main(int argc,char** argv)
 
 	Editor window;
 	window.show();
+	if (!parser.positionalArguments().isEmpty())
+		window.Load(parser.positionalArguments().front().toStdString());
 
 	return app.exec();
 }
\ No newline at end of file
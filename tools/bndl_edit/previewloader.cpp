@@ -0,0 +1,126 @@
+#include "previewloader.hpp"
+#include <QRunnable>
+#include <algorithm>
+
+using namespace libbndl;
+
+namespace
+{
+	template <typename Func>
+	class Job : public QRunnable
+	{
+	public:
+		explicit Job(Func &&func) : m_func(std::move(func))
+		{
+		}
+
+		void run() override
+		{
+			m_func();
+		}
+
+	private:
+		Func m_func;
+	};
+
+	template <typename Func>
+	QRunnable *MakeJob(Func &&func)
+	{
+		return new Job<std::decay_t<Func>>(std::forward<Func>(func));
+	}
+}
+
+PreviewLoader::PreviewLoader(const Bundle &bundle, QObject *parent)
+	: QObject(parent), m_bundle(bundle), m_cache(CacheSize), m_generation(std::make_shared<std::atomic<uint64_t>>(0))
+{
+	// One worker is plenty: only the newest request matters.
+	m_pool.setMaxThreadCount(1);
+}
+
+PreviewLoader::~PreviewLoader()
+{
+	Cancel();
+	m_pool.waitForDone();
+}
+
+void PreviewLoader::Request(uint32_t resourceID)
+{
+	const auto generation = ++*m_generation;
+	const auto epoch = m_epoch;
+
+	if (const auto cached = m_cache.object(resourceID))
+	{
+		emit Ready(resourceID, *cached);
+		return;
+	}
+
+	m_pool.start(MakeJob([this, resourceID, generation, epoch, current = m_generation]
+	{
+		if (*current != generation)
+			return;
+
+		auto preview = Decode(m_bundle, resourceID);
+
+		QMetaObject::invokeMethod(this, [this, resourceID, generation, epoch, preview = std::move(preview)]
+		{
+			// Results queued before a Clear describe the old bundle.
+			if (m_epoch != epoch)
+				return;
+
+			m_cache.insert(resourceID, new QString(preview));
+			if (*m_generation == generation)
+				emit Ready(resourceID, preview);
+		}, Qt::QueuedConnection);
+	}));
+}
+
+void PreviewLoader::Cancel()
+{
+	++*m_generation;
+}
+
+void PreviewLoader::Clear()
+{
+	Cancel();
+	m_pool.waitForDone();
+	m_cache.clear();
+	m_epoch++;
+}
+
+QString PreviewLoader::Decode(const Bundle &bundle, uint32_t resourceID)
+{
+	const auto entry = bundle.GetEntry(resourceID);
+	if (!entry)
+		return tr("Resource %1 is gone.").arg(resourceID, 8, 16, QChar('0'));
+
+	auto preview = tr("ID: %1\nType: %2\nSize: %3, %4, %5 bytes\nDependencies: %6\n\n")
+		.arg(resourceID, 8, 16, QChar('0'))
+		.arg(entry->debugInfo ? QString::fromStdString(entry->debugInfo->typeName) : QString::number(static_cast<uint>(entry->resourceType), 16))
+		.arg(entry->uncompressedSize[0]).arg(entry->uncompressedSize[1]).arg(entry->uncompressedSize[2])
+		.arg(entry->numberOfDependencies);
+
+	const auto data = bundle.GetBinaryPrefix(resourceID, 0, PreviewSize);
+	if (data == nullptr)
+		return preview + tr("No data in block 0.");
+
+	// Mostly printable data is shown as text, anything else as a hex dump.
+	const auto printable = std::count_if(data->begin(), data->end(), [](uint8_t c)
+	{
+		return (c >= 0x20 && c < 0x7F) || c == '\n' || c == '\r' || c == '\t';
+	});
+	if (!data->empty() && printable * 20 >= static_cast<ptrdiff_t>(data->size()) * 19)
+		return preview + QString::fromLatin1(reinterpret_cast<const char *>(data->data()), static_cast<int>(data->size()));
+
+	for (size_t offset = 0; offset < data->size(); offset += 16)
+	{
+		preview += QString("%1 ").arg(static_cast<qulonglong>(offset), 8, 16, QChar('0'));
+		const auto end = std::min(offset + 16, data->size());
+		for (auto i = offset; i < end; i++)
+			preview += QString(" %1").arg(static_cast<uint>((*data)[i]), 2, 16, QChar('0'));
+		preview += '\n';
+	}
+	if (data->size() < entry->uncompressedSize[0])
+		preview += tr("... %1 more bytes").arg(static_cast<qulonglong>(entry->uncompressedSize[0] - data->size()));
+
+	return preview;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <QCache>
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+#include <libbndl/bundle.hpp>
+#include <atomic>
+#include <memory>
+
+// Decodes previews off the GUI thread. Only the latest request is delivered; older ones are dropped
+// before they start or when they finish. Recently decoded previews are served from a small cache.
+class PreviewLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit PreviewLoader(const libbndl::Bundle &bundle, QObject *parent = nullptr);
+	~PreviewLoader() override;
+
+	void Request(uint32_t resourceID);
+	void Cancel();
+	// Must be called before the bundle changes: waits for running work and forgets cached previews.
+	void Clear();
+
+signals:
+	void Ready(uint32_t resourceID, const QString &preview);
+
+private:
+	static constexpr size_t PreviewSize = 4096; // Bytes of block 0 that are decoded
+	static constexpr int CacheSize = 256; // Previews
+
+	static QString Decode(const libbndl::Bundle &bundle, uint32_t resourceID);
+
+	const libbndl::Bundle &m_bundle;
+	QThreadPool m_pool;
+	QCache<uint32_t, QString> m_cache;
+	std::shared_ptr<std::atomic<uint64_t>> m_generation; // Bumped by every request and cancel
+	uint64_t m_epoch = 0; // Bumped by every Clear; only touched on the GUI thread
+};
@@ -0,0 +1,317 @@
+#include "batch.hpp"
+#include "layout.hpp"
+#include "threadpool.hpp"
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+using namespace libbndl;
+
+namespace
+{
+	struct Totals
+	{
+		uint64_t resources = 0;
+		uint64_t uncompressedSize = 0;
+		uint64_t compressedSize = 0; // Equal to the uncompressed size for uncompressed bundles.
+	};
+
+	struct BundleReport
+	{
+		std::filesystem::path path;
+		bool loaded = false;
+		std::string magic;
+		std::string platform;
+		bool compressed = false;
+		Totals totals;
+		std::map<uint32_t, Totals> byType;
+		uint64_t verifyFailures = 0;
+		std::vector<Bundle::EntryView> entries;
+		std::vector<std::string> names; // Debug names of the entries, as the views don't outlive the bundle.
+	};
+
+	bool IsBundle(const std::filesystem::path &path)
+	{
+		char magic[4] = {};
+		std::ifstream file(path, std::ios::in | std::ios::binary);
+		file.read(magic, sizeof(magic));
+		return file.gcount() == sizeof(magic) && (std::string(magic, 4) == "bnd2" || std::string(magic, 4) == "bndl");
+	}
+
+	std::string PlatformName(Bundle::Platform platform)
+	{
+		switch (platform)
+		{
+		case Bundle::PC:
+			return "pc";
+		case Bundle::Xbox360:
+			return "xbox360";
+		case Bundle::PS3:
+			return "ps3";
+		default:
+			return layout::Hex(platform);
+		}
+	}
+
+	double Ratio(const Totals &totals)
+	{
+		return totals.uncompressedSize == 0 ? 1.0 : static_cast<double>(totals.compressedSize) / totals.uncompressedSize;
+	}
+
+	void Examine(BundleReport &report, BatchOptions::Operation operation)
+	{
+		Bundle bundle;
+		if (!bundle.Load(report.path.string()))
+			return;
+
+		report.loaded = true;
+		report.magic = bundle.GetMagicVersion() == Bundle::BNDL ? "bndl" : "bnd2";
+		report.platform = PlatformName(bundle.GetPlatform());
+		report.compressed = (bundle.GetFlags() & Bundle::Compressed) != 0;
+
+		std::vector<uint8_t> buffer;
+		for (const auto &entry : bundle.Entries())
+		{
+			auto &typeTotals = report.byType[entry.resourceType];
+			for (auto *totals : { &report.totals, &typeTotals })
+			{
+				totals->resources++;
+				for (auto i = 0; i < 3; i++)
+				{
+					totals->uncompressedSize += entry.uncompressedSize[i];
+					totals->compressedSize += report.compressed ? entry.compressedSize[i] : entry.uncompressedSize[i];
+				}
+			}
+
+			if (operation == BatchOptions::List)
+			{
+				report.entries.push_back(entry);
+				report.entries.back().debugInfo = nullptr;
+				report.names.push_back(entry.debugInfo ? entry.debugInfo->name : std::string());
+			}
+
+			if (operation == BatchOptions::Verify)
+			{
+				for (auto i = 0U; i < 3; i++)
+				{
+					if (entry.uncompressedSize[i] == 0)
+						continue;
+
+					buffer.resize(entry.uncompressedSize[i]);
+					if (!bundle.ReadBinary(entry.resourceID, i, buffer.data(), buffer.size()))
+						report.verifyFailures++;
+				}
+			}
+		}
+	}
+
+	std::string JsonString(const std::string &value)
+	{
+		std::string escaped = "\"";
+		for (const auto c : value)
+		{
+			if (c == '"' || c == '\\')
+			{
+				escaped += '\\';
+				escaped += c;
+			}
+			else if (static_cast<unsigned char>(c) < 0x20)
+			{
+				char code[8];
+				std::snprintf(code, sizeof(code), "\\u%04x", c);
+				escaped += code;
+			}
+			else
+			{
+				escaped += c;
+			}
+		}
+		return escaped + '"';
+	}
+
+	std::string CsvString(const std::string &value)
+	{
+		if (value.find_first_of(",\"\n") == std::string::npos)
+			return value;
+
+		std::string escaped = "\"";
+		for (const auto c : value)
+		{
+			if (c == '"')
+				escaped += '"';
+			escaped += c;
+		}
+		return escaped + '"';
+	}
+
+	void WriteJsonTotals(std::ostream &out, const Totals &totals)
+	{
+		out << "\"resources\":" << totals.resources << ",\"uncompressedSize\":" << totals.uncompressedSize
+			<< ",\"compressedSize\":" << totals.compressedSize << ",\"ratio\":" << Ratio(totals);
+	}
+
+	void WriteJson(std::ostream &out, const BundleReport &report, BatchOptions::Operation operation)
+	{
+		out << "{\"path\":" << JsonString(report.path.generic_string()) << ",\"loaded\":" << (report.loaded ? "true" : "false");
+		if (!report.loaded)
+		{
+			out << '}';
+			return;
+		}
+
+		out << ",\"format\":\"" << report.magic << "\",\"platform\":\"" << report.platform << "\",\"compressed\":" << (report.compressed ? "true" : "false") << ',';
+		WriteJsonTotals(out, report.totals);
+		if (operation == BatchOptions::Verify)
+			out << ",\"verifyFailures\":" << report.verifyFailures;
+
+		out << ",\"types\":[";
+		auto first = true;
+		for (const auto &[resourceType, totals] : report.byType)
+		{
+			out << (first ? "" : ",") << "{\"type\":\"" << layout::Hex(resourceType) << "\",";
+			WriteJsonTotals(out, totals);
+			out << '}';
+			first = false;
+		}
+		out << ']';
+
+		if (operation == BatchOptions::List)
+		{
+			out << ",\"entries\":[";
+			for (auto i = 0U; i < report.entries.size(); i++)
+			{
+				const auto &entry = report.entries[i];
+				out << (i == 0 ? "" : ",") << "{\"id\":\"" << layout::Hex(entry.resourceID) << "\",\"type\":\"" << layout::Hex(entry.resourceType)
+					<< "\",\"uncompressedSize\":[" << entry.uncompressedSize[0] << ',' << entry.uncompressedSize[1] << ',' << entry.uncompressedSize[2]
+					<< "],\"compressedSize\":[" << entry.compressedSize[0] << ',' << entry.compressedSize[1] << ',' << entry.compressedSize[2]
+					<< "],\"name\":" << JsonString(report.names[i]) << '}';
+			}
+			out << ']';
+		}
+
+		out << '}';
+	}
+
+	void WriteCsv(std::ostream &out, const BundleReport &report, BatchOptions::Operation operation)
+	{
+		const auto path = CsvString(report.path.generic_string());
+		if (!report.loaded)
+		{
+			out << path << ",false\n";
+			return;
+		}
+
+		if (operation == BatchOptions::List)
+		{
+			for (auto i = 0U; i < report.entries.size(); i++)
+			{
+				const auto &entry = report.entries[i];
+				out << path << ",true," << layout::Hex(entry.resourceID) << ',' << layout::Hex(entry.resourceType);
+				for (const auto size : entry.uncompressedSize)
+					out << ',' << size;
+				for (const auto size : entry.compressedSize)
+					out << ',' << size;
+				out << ',' << CsvString(report.names[i]) << '\n';
+			}
+			return;
+		}
+
+		// One row for the whole bundle, then one per type.
+		const auto writeRow = [&](const std::string &type, const Totals &totals)
+		{
+			out << path << ",true," << report.magic << ',' << report.platform << ',' << (report.compressed ? "true" : "false") << ',' << type << ','
+				<< totals.resources << ',' << totals.uncompressedSize << ',' << totals.compressedSize << ',' << Ratio(totals);
+			if (operation == BatchOptions::Verify)
+				out << ',' << report.verifyFailures;
+			out << '\n';
+		};
+
+		writeRow("all", report.totals);
+		for (const auto &[resourceType, totals] : report.byType)
+			writeRow(layout::Hex(resourceType), totals);
+	}
+}
+
+bool Batch(const BatchOptions &options)
+{
+	std::vector<BundleReport> reports;
+	std::error_code error;
+	// Entering an unreadable directory fails on the step after it, so the last path seen is the one to blame.
+	auto failedPath = options.directory;
+	auto it = std::filesystem::recursive_directory_iterator(options.directory, error);
+	for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+	{
+		failedPath = it->path();
+		if (!it->is_regular_file(error))
+		{
+			if (error)
+				break;
+			continue;
+		}
+		if (!IsBundle(it->path()))
+			continue;
+
+		BundleReport report;
+		report.path = it->path();
+		reports.push_back(std::move(report));
+	}
+	if (error)
+	{
+		std::cout << "Failed to read " << failedPath.string() << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	// Directory order varies between filesystems, so sort to keep reports comparable.
+	std::sort(reports.begin(), reports.end(), [](const BundleReport &a, const BundleReport &b) { return a.path < b.path; });
+
+	{
+		ThreadPool pool(options.threads);
+		for (auto &report : reports)
+			pool.Submit([&report, &options] { Examine(report, options.operation); });
+		pool.Wait();
+	}
+
+	// Build the whole report in memory and write it out in one go.
+	std::ostringstream out;
+	if (options.format == BatchOptions::Json)
+	{
+		out << "{\"bundles\":[\n";
+		for (auto i = 0U; i < reports.size(); i++)
+		{
+			WriteJson(out, reports[i], options.operation);
+			out << (i + 1 < reports.size() ? ",\n" : "\n");
+		}
+		out << "]}\n";
+	}
+	else
+	{
+		if (options.operation == BatchOptions::List)
+			out << "path,loaded,id,type,uncompressedSize0,uncompressedSize1,uncompressedSize2,compressedSize0,compressedSize1,compressedSize2,name\n";
+		else
+			out << "path,loaded,format,platform,compressed,type,resources,uncompressedSize,compressedSize,ratio" << (options.operation == BatchOptions::Verify ? ",verifyFailures" : "") << '\n';
+		for (const auto &report : reports)
+			WriteCsv(out, report, options.operation);
+	}
+
+	const auto text = out.str();
+	if (options.output.empty())
+	{
+		std::cout.write(text.data(), text.size());
+		std::cout.flush();
+	}
+	else if (!layout::WriteFile(options.output, text))
+	{
+		std::cout << "Failed to write " << options.output << std::endl;
+		return false;
+	}
+
+	auto failed = false;
+	for (const auto &report : reports)
+		failed |= !report.loaded || report.verifyFailures > 0;
+
+	return !failed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <filesystem>
+#include <string>
+
+struct BatchOptions
+{
+	enum Operation
+	{
+		List, // Every entry of every bundle.
+		Stat, // Totals per bundle and per resource type.
+		Verify // Stat, plus inflating every block to check it.
+	};
+
+	enum Format
+	{
+		Json,
+		Csv
+	};
+
+	std::filesystem::path directory;
+	std::string output; // stdout if empty.
+	Operation operation;
+	Format format;
+	unsigned threads;
+};
+
+bool Batch(const BatchOptions &options);
@@ -0,0 +1,192 @@
+#include "bench.hpp"
+#include "layout.hpp"
+#include "threadpool.hpp"
+#include <libbndl/bundle.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+
+using namespace libbndl;
+
+namespace
+{
+	using Clock = std::chrono::steady_clock;
+
+	struct Sample
+	{
+		uint64_t uncompressedSize = 0;
+		uint64_t storedSize = 0;
+		double readSeconds = 0;
+		std::vector<uint64_t> recompressedSizes; // One per level.
+		std::vector<double> recompressSeconds;
+		bool failed = false;
+	};
+
+	struct TypeResults
+	{
+		uint64_t uncompressedSize = 0;
+		uint64_t storedSize = 0;
+		double readSeconds = 0;
+		std::vector<double> latencies;
+		std::vector<uint64_t> recompressedSizes;
+		std::vector<double> recompressSeconds;
+	};
+
+	double Seconds(Clock::time_point start)
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	void Measure(const Bundle &bundle, const Bundle::EntryView &entry, const std::vector<Bundle> &compressors, Sample &sample)
+	{
+		const auto compressed = (bundle.GetFlags() & Bundle::Compressed) != 0;
+		for (auto i = 0U; i < 3; i++)
+		{
+			sample.uncompressedSize += entry.uncompressedSize[i];
+			sample.storedSize += compressed ? entry.compressedSize[i] : entry.uncompressedSize[i];
+		}
+
+		const auto start = Clock::now();
+		for (auto i = 0U; i < 3; i++)
+		{
+			if (entry.uncompressedSize[i] > 0 && bundle.GetBinary(entry.resourceID, i) == nullptr)
+				sample.failed = true;
+		}
+		sample.readSeconds = Seconds(start);
+
+		if (compressors.empty())
+			return;
+
+		const auto data = bundle.GetData(entry.resourceID);
+		if (!data)
+		{
+			sample.failed = true;
+			return;
+		}
+
+		for (const auto &compressor : compressors)
+		{
+			const auto compressStart = Clock::now();
+			const auto recompressed = compressor.CompressResource(*data);
+			sample.recompressSeconds.push_back(Seconds(compressStart));
+
+			uint64_t size = 0;
+			if (recompressed)
+			{
+				for (const auto &block : recompressed->fileBlockData)
+					size += block ? block->size() : 0;
+			}
+			else
+			{
+				sample.failed = true;
+			}
+			sample.recompressedSizes.push_back(size);
+		}
+	}
+
+	double Percentile(const std::vector<double> &sorted, unsigned percentile)
+	{
+		if (sorted.empty())
+			return 0;
+		return sorted[std::min(sorted.size() - 1, sorted.size() * percentile / 100)];
+	}
+
+	double MegabytesPerSecond(uint64_t bytes, double seconds)
+	{
+		return seconds > 0 ? bytes / seconds / (1024 * 1024) : 0;
+	}
+}
+
+bool Bench(const BenchOptions &options)
+{
+	Bundle bundle;
+	bundle.SetCacheDirectory(options.cacheDirectory);
+	if (!bundle.Load(options.file))
+	{
+		std::cout << "Failed to open " << options.file << std::endl;
+		return false;
+	}
+
+	bundle.SetMemoryBudget(options.memoryBudget);
+	const auto footprint = bundle.GetMemoryFootprint();
+
+	// Bundles that only serve as compression settings, one per level.
+	std::vector<Bundle> compressors;
+	for (const auto level : options.compressionLevels)
+	{
+		compressors.emplace_back(bundle.GetMagicVersion(), bundle.GetRevisionNumber(), bundle.GetPlatform(), static_cast<Bundle::Flags>(bundle.GetFlags() | Bundle::Compressed));
+		compressors.back().SetCompressionLevel(level);
+	}
+
+	const auto range = bundle.Entries();
+	const std::vector<Bundle::EntryView> entries(range.begin(), range.end());
+	std::vector<Sample> samples(entries.size());
+
+	const auto start = Clock::now();
+	{
+		ThreadPool pool(options.threads);
+		for (auto i = 0U; i < entries.size(); i++)
+			pool.Submit([&bundle, &entries, &compressors, &samples, i] { Measure(bundle, entries[i], compressors, samples[i]); });
+		pool.Wait();
+	}
+	const auto wallSeconds = Seconds(start);
+
+	std::map<Bundle::ResourceType, TypeResults> byType;
+	size_t failures = 0;
+	for (auto i = 0U; i < entries.size(); i++)
+	{
+		const auto &sample = samples[i];
+		auto &results = byType[entries[i].resourceType];
+		failures += sample.failed;
+
+		results.uncompressedSize += sample.uncompressedSize;
+		results.storedSize += sample.storedSize;
+		results.readSeconds += sample.readSeconds;
+		results.latencies.push_back(sample.readSeconds);
+
+		results.recompressedSizes.resize(compressors.size());
+		results.recompressSeconds.resize(compressors.size());
+		for (auto j = 0U; j < sample.recompressedSizes.size(); j++)
+		{
+			results.recompressedSizes[j] += sample.recompressedSizes[j];
+			results.recompressSeconds[j] += sample.recompressSeconds[j];
+		}
+	}
+
+	std::cout << entries.size() << " resources on " << options.threads << " threads in " << std::fixed << std::setprecision(2) << wallSeconds << " s" << std::endl;
+	std::cout << "Read rates are per thread. Latencies are per resource in microseconds." << std::endl;
+	std::cout << "Resident after load: " << footprint.total << " bytes, " << footprint.fileBuffers + footprint.blockBuffers << " of them payloads, "
+		<< footprint.releasedBlocks << " blocks left in the file" << std::endl;
+
+	std::cout << std::left << std::setw(10) << "TYPE" << std::right << std::setw(8) << "COUNT" << std::setw(14) << "BYTES" << std::setw(8) << "RATIO"
+		<< std::setw(10) << "READ MB/S" << std::setw(10) << "P50" << std::setw(10) << "P90" << std::setw(10) << "P99" << std::setw(10) << "MAX";
+	for (const auto level : options.compressionLevels)
+		std::cout << std::setw(8) << ("L" + std::to_string(level)) << std::setw(10) << "MB/S";
+	std::cout << std::endl;
+
+	for (auto &[resourceType, results] : byType)
+	{
+		std::sort(results.latencies.begin(), results.latencies.end());
+		const auto ratio = results.uncompressedSize ? static_cast<double>(results.storedSize) / results.uncompressedSize : 1.0;
+
+		std::cout << std::left << std::setw(10) << layout::Hex(resourceType) << std::right << std::setw(8) << results.latencies.size()
+			<< std::setw(14) << results.uncompressedSize << std::setw(8) << std::setprecision(3) << ratio
+			<< std::setw(10) << std::setprecision(1) << MegabytesPerSecond(results.uncompressedSize, results.readSeconds)
+			<< std::setw(10) << Percentile(results.latencies, 50) * 1e6 << std::setw(10) << Percentile(results.latencies, 90) * 1e6
+			<< std::setw(10) << Percentile(results.latencies, 99) * 1e6 << std::setw(10) << results.latencies.back() * 1e6;
+		for (auto j = 0U; j < compressors.size(); j++)
+		{
+			const auto levelRatio = results.uncompressedSize ? static_cast<double>(results.recompressedSizes[j]) / results.uncompressedSize : 1.0;
+			std::cout << std::setw(8) << std::setprecision(3) << levelRatio
+				<< std::setw(10) << std::setprecision(1) << MegabytesPerSecond(results.uncompressedSize, results.recompressSeconds[j]);
+		}
+		std::cout << std::endl;
+	}
+
+	if (failures > 0)
+		std::cout << failures << " resources failed to read or recompress." << std::endl;
+
+	return failures == 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct BenchOptions
+{
+	std::string file;
+	std::vector<int> compressionLevels; // Recompress at each of these; none skips recompression.
+	unsigned threads;
+	std::string cacheDirectory; // Empty leaves the decompressed block cache off.
+	uint64_t memoryBudget; // Bytes, 0 for none
+};
+
+bool Bench(const BenchOptions &options);
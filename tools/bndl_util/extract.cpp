@@ -0,0 +1,120 @@
+#include "extract.hpp"
+#include "layout.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+using namespace libbndl;
+
+namespace
+{
+	struct ExtractJob
+	{
+		uint32_t resourceID;
+		Bundle::ResourceType resourceType;
+		std::optional<Bundle::EntryDebugInfo> debugInfo;
+	};
+
+	bool Matches(const Bundle::EntryView &entry, const ExtractOptions &options)
+	{
+		const auto contains = [](const std::vector<uint32_t> &values, uint32_t value)
+		{
+			return values.empty() || std::find(values.begin(), values.end(), value) != values.end();
+		};
+
+		if (!contains(options.resourceTypes, entry.resourceType) || !contains(options.resourceIDs, entry.resourceID))
+			return false;
+
+		return options.name.empty() || (entry.debugInfo && entry.debugInfo->name.find(options.name) != std::string::npos);
+	}
+
+	bool ExtractResource(const Bundle &bundle, const ExtractJob &job, const std::filesystem::path &root)
+	{
+		auto data = bundle.GetData(job.resourceID);
+		if (!data)
+			return false;
+
+		const auto directory = layout::ResourceDirectory(root, job.resourceType, job.resourceID);
+		std::error_code error;
+		std::filesystem::create_directory(directory, error);
+		if (error)
+			return false;
+
+		std::ostringstream info;
+		info << "type " << layout::Hex(job.resourceType) << '\n';
+		for (auto i = 0U; i < 3; i++)
+		{
+			info << "alignment " << i << ' ' << data->alignments[i] << '\n';
+
+			const auto &block = data->fileBlockData[i];
+			if (block && !layout::WriteFile(layout::BlockFile(directory, i), block->data(), block->size()))
+				return false;
+		}
+		for (const auto &dependency : data->dependencies)
+			info << "dependency " << layout::Hex(dependency.resourceID) << ' ' << layout::Hex(dependency.internalOffset) << '\n';
+		if (job.debugInfo)
+		{
+			info << "name " << job.debugInfo->name << '\n';
+			info << "typename " << job.debugInfo->typeName << '\n';
+		}
+
+		return layout::WriteFile(directory / layout::ResourceInfoFile, info.str());
+	}
+}
+
+bool Extract(const Bundle &bundle, const ExtractOptions &options)
+{
+	std::vector<ExtractJob> jobs;
+	std::set<Bundle::ResourceType> resourceTypes;
+	for (const auto &entry : bundle.Entries())
+	{
+		if (!Matches(entry, options))
+			continue;
+
+		ExtractJob job = { entry.resourceID, entry.resourceType, {} };
+		if (entry.debugInfo)
+			job.debugInfo = *entry.debugInfo;
+		jobs.push_back(std::move(job));
+		resourceTypes.insert(entry.resourceType);
+	}
+
+	// Make the shared directories up front so workers never race to create them.
+	std::error_code error;
+	std::filesystem::create_directories(options.directory, error);
+	for (const auto resourceType : resourceTypes)
+		std::filesystem::create_directories(layout::TypeDirectory(options.directory, resourceType), error);
+	if (error)
+	{
+		std::cout << "Failed to create " << options.directory.string() << ": " << error.message() << std::endl;
+		return false;
+	}
+
+	std::ostringstream bundleInfo;
+	bundleInfo << "magic " << (bundle.GetMagicVersion() == Bundle::BNDL ? "bndl" : "bnd2") << '\n';
+	bundleInfo << "revision " << bundle.GetRevisionNumber() << '\n';
+	bundleInfo << "platform " << layout::Hex(bundle.GetPlatform()) << '\n';
+	bundleInfo << "flags " << layout::Hex(bundle.GetFlags()) << '\n';
+	if (!layout::WriteFile(options.directory / layout::BundleInfoFile, bundleInfo.str()))
+		return false;
+
+	std::atomic<size_t> failures = 0;
+	{
+		ThreadPool pool(options.threads);
+		for (const auto &job : jobs)
+		{
+			pool.Submit([&bundle, &job, &options, &failures]
+			{
+				if (!ExtractResource(bundle, job, options.directory))
+					failures++;
+			});
+		}
+		pool.Wait();
+	}
+
+	std::cout << "Extracted " << jobs.size() - failures << " of " << jobs.size() << " resources to " << options.directory.string() << std::endl;
+
+	return failures == 0;
+}
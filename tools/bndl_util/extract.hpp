@@ -0,0 +1,16 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct ExtractOptions
+{
+	std::filesystem::path directory;
+	std::vector<uint32_t> resourceTypes; // Empty means every type.
+	std::vector<uint32_t> resourceIDs; // Empty means every resource.
+	std::string name; // Only resources whose debug name contains this, if set.
+	unsigned threads;
+};
+
+bool Extract(const libbndl::Bundle &bundle, const ExtractOptions &options);
@@ -0,0 +1,90 @@
+#include "layout.hpp"
+#include <charconv>
+#include <cstdio>
+#include <iomanip>
+#include <sstream>
+
+#if defined(__linux__)
+#	include <fcntl.h>
+#endif
+
+using namespace libbndl;
+
+std::string layout::Hex(uint32_t value)
+{
+	std::ostringstream stream;
+	stream << std::hex << std::setw(8) << std::setfill('0') << value;
+	return stream.str();
+}
+
+std::optional<uint32_t> layout::ParseHex(const std::string &text)
+{
+	auto begin = text.data();
+	const auto end = text.data() + text.size();
+	if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+		begin += 2;
+
+	uint32_t value;
+	const auto result = std::from_chars(begin, end, value, 16);
+	if (begin == end || result.ec != std::errc() || result.ptr != end)
+		return {};
+
+	return value;
+}
+
+std::filesystem::path layout::TypeDirectory(const std::filesystem::path &root, Bundle::ResourceType resourceType)
+{
+	return root / Hex(resourceType);
+}
+
+std::filesystem::path layout::ResourceDirectory(const std::filesystem::path &root, Bundle::ResourceType resourceType, uint32_t resourceID)
+{
+	return TypeDirectory(root, resourceType) / Hex(resourceID);
+}
+
+std::filesystem::path layout::BlockFile(const std::filesystem::path &resourceDirectory, uint32_t fileBlock)
+{
+	return resourceDirectory / ("block" + std::to_string(fileBlock) + ".bin");
+}
+
+std::unique_ptr<std::vector<uint8_t>> layout::ReadFile(const std::filesystem::path &path)
+{
+	std::error_code error;
+	const auto size = std::filesystem::file_size(path, error);
+	if (error)
+		return {};
+
+	auto file = std::fopen(path.string().c_str(), "rb");
+	if (file == nullptr)
+		return {};
+
+	auto data = std::make_unique<std::vector<uint8_t>>(size);
+	const auto read = std::fread(data->data(), 1, size, file);
+	std::fclose(file);
+
+	if (read != size)
+		return {};
+
+	return data;
+}
+
+bool layout::WriteFile(const std::filesystem::path &path, const uint8_t *data, size_t size)
+{
+	auto file = std::fopen(path.string().c_str(), "wb");
+	if (file == nullptr)
+		return false;
+
+#if defined(__linux__)
+	// Reserve the whole file first so the filesystem can lay it out in one piece.
+	if (size > 0)
+		posix_fallocate(fileno(file), 0, static_cast<off_t>(size));
+#endif
+
+	const auto written = std::fwrite(data, 1, size, file);
+	return std::fclose(file) == 0 && written == size;
+}
+
+bool layout::WriteFile(const std::filesystem::path &path, const std::string &text)
+{
+	return WriteFile(path, reinterpret_cast<const uint8_t *>(text.data()), text.size());
+}
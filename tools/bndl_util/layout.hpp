@@ -0,0 +1,28 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+// How bundles are extracted to disk, which is also what pack reads back:
+//   bundle.txt                   magic, revision, platform and flags
+//   <type>/<id>/block<n>.bin     one file per non-empty block, with the type and ID in hex
+//   <type>/<id>/resource.txt     type, alignments, dependencies and debug info
+namespace layout
+{
+	constexpr const char *BundleInfoFile = "bundle.txt";
+	constexpr const char *ResourceInfoFile = "resource.txt";
+
+	std::string Hex(uint32_t value);
+	// Accepts an optional 0x prefix. Anything else that isn't a 32-bit hex number gives nothing.
+	std::optional<uint32_t> ParseHex(const std::string &text);
+	std::filesystem::path TypeDirectory(const std::filesystem::path &root, libbndl::Bundle::ResourceType resourceType);
+	std::filesystem::path ResourceDirectory(const std::filesystem::path &root, libbndl::Bundle::ResourceType resourceType, uint32_t resourceID);
+	std::filesystem::path BlockFile(const std::filesystem::path &resourceDirectory, uint32_t fileBlock);
+
+	std::unique_ptr<std::vector<uint8_t>> ReadFile(const std::filesystem::path &path);
+	bool WriteFile(const std::filesystem::path &path, const uint8_t *data, size_t size);
+	bool WriteFile(const std::filesystem::path &path, const std::string &text);
+}
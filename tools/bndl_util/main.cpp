@@ -1,10 +1,48 @@
+#include "batch.hpp"
+#include "bench.hpp"
+#include "extract.hpp"
+#include "layout.hpp"
+#include "pack.hpp"
+#include "threadpool.hpp"
 #include <libbndl/bundle.hpp>
 #include <iostream>
 #include <iomanip>
+#include <optional>
+#include <sstream>
 #include <cxxopts.hpp>
 
 using namespace libbndl;
 
+namespace
+{
+	// Splits a comma separated list of hex numbers. Nothing if any of them isn't one.
+	std::optional<std::vector<uint32_t>> ParseHexList(const std::string &list)
+	{
+		std::vector<uint32_t> values;
+		std::istringstream stream(list);
+		std::string value;
+		while (std::getline(stream, value, ','))
+		{
+			if (value.empty())
+				continue;
+
+			const auto parsed = layout::ParseHex(value);
+			if (!parsed)
+				return {};
+			values.push_back(*parsed);
+		}
+		return values;
+	}
+
+	// A zlib compression level, 0-9. Nothing for anything else.
+	std::optional<int> ParseLevel(const std::string &level)
+	{
+		if (level.size() != 1 || level[0] < '0' || level[0] > '9')
+			return {};
+		return level[0] - '0';
+	}
+}
+
 int main(int argc, char** argv)
 {
 	cxxopts::Options options("bndl_util", "A program to work with Burnout Paradise bundle archives.");
@@ -13,29 +51,169 @@ int main(int argc, char** argv)
 		("p,pack", "Pack a folder structure to a bundle archive")
 		("f,file", "Name of the archive that should be extracted/generated", cxxopts::value<std::string>())
 		("s,search", "Search for an entry", cxxopts::value<std::string>())
-		("l,list", "List all entries");
+		("l,list", "List all entries")
+		("d,directory", "Folder to extract to or pack from (defaults to the archive name without its extension)", cxxopts::value<std::string>())
+		("t,type", "Only extract these resource types (hex, comma separated)", cxxopts::value<std::string>())
+		("i,id", "Only extract these resource IDs (hex, comma separated)", cxxopts::value<std::string>())
+		("n,name", "Only extract resources whose debug name contains this", cxxopts::value<std::string>())
+		("j,threads", "Number of worker threads", cxxopts::value<unsigned>())
+		("format", "Packing a plain folder: bnd2 or bndl", cxxopts::value<std::string>())
+		("platform", "Packing a plain folder: pc, xbox360 or ps3", cxxopts::value<std::string>())
+		("uncompressed", "Packing a plain folder: don't compress the bundle")
+		("resource-type", "Packing a plain folder: resource type of every file (hex)", cxxopts::value<std::string>())
+		("level", "zlib compression level used when packing, 0-9", cxxopts::value<std::string>())
+		("dedup", "Packing: store byte-identical blocks once (BND2 only)")
+		("layout", "Packing: order data by an access trace file, or by dependencies (BND2 only)", cxxopts::value<std::string>())
+		("cache", "Keep decompressed blocks in this folder and reuse them on later runs (extract and bench)", cxxopts::value<std::string>())
+		("memory-budget", "Keep at most this many MiB of stored blocks in memory, reading the rest from the file (extract and bench)", cxxopts::value<uint64_t>())
+		("record-access", "Extracting: write the order resources were read in to this access trace file", cxxopts::value<std::string>())
+		("b,batch", "Run list, stat or verify on every bundle under --directory", cxxopts::value<std::string>())
+		("report", "Batch report format: json or csv", cxxopts::value<std::string>())
+		("o,output", "Write the batch report here instead of to stdout", cxxopts::value<std::string>())
+		("bench", "Time reading every resource and recompressing it, grouped by type")
+		("levels", "Compression levels the bench tries (comma separated, or none)", cxxopts::value<std::string>());
 
 	options.parse(argc, argv);
+	const auto threads = options.count("threads") ? options["threads"].as<unsigned>() : ThreadPool::DefaultThreadCount();
+
+	if (options.count("batch"))
+	{
+		BatchOptions batchOptions;
+		const auto operation = options["batch"].as<std::string>();
+		if (operation == "list")
+			batchOptions.operation = BatchOptions::List;
+		else if (operation == "stat")
+			batchOptions.operation = BatchOptions::Stat;
+		else if (operation == "verify")
+			batchOptions.operation = BatchOptions::Verify;
+		else
+		{
+			std::cout << "Unknown batch operation " << operation << "." << std::endl << options.help() << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		if (options.count("directory") == 0)
+		{
+			std::cout << "Please specify a folder to process." << std::endl << options.help() << std::endl;
+			return EXIT_FAILURE;
+		}
+
+		batchOptions.directory = options["directory"].as<std::string>();
+		batchOptions.format = options.count("report") && options["report"].as<std::string>() == "csv" ? BatchOptions::Csv : BatchOptions::Json;
+		if (options.count("output"))
+			batchOptions.output = options["output"].as<std::string>();
+		batchOptions.threads = threads;
+
+		return Batch(batchOptions) ? 0 : EXIT_FAILURE;
+	}
 	if (options.count("file") == 0)
 	{
 		std::cout << "Please specify an input file." << std::endl << options.help() << std::endl;
 		return EXIT_FAILURE;
 	}
 
-	bool extract = options["pack"].as<bool>();
+	bool extract = options["extract"].as<bool>();
 	bool pack = options["pack"].as<bool>();
 	bool list = options["list"].as<bool>();
 	std::string file = options["file"].as<std::string>();
 	std::string search = options["search"].as<std::string>();
 	bool bsearch = search.size() > 0;
+	bool bench = options["bench"].as<bool>();
 	
-	if ((pack + extract + list + bsearch) != 1)
+	if ((pack + extract + list + bsearch + bench) != 1)
 	{
 		std::cout << "Please specify exactly one operation that should be executed." << std::endl
 		<< options.help() << std::endl;
 		return EXIT_FAILURE;
 	}
 
+	const auto directory = options.count("directory") ? std::filesystem::path(options["directory"].as<std::string>()) : std::filesystem::path(file).replace_extension();
+	if (bench)
+	{
+		BenchOptions benchOptions;
+		benchOptions.file = file;
+		const auto levels = options.count("levels") ? options["levels"].as<std::string>() : "1,6,9";
+		if (levels != "none")
+		{
+			std::istringstream stream(levels);
+			std::string level;
+			while (std::getline(stream, level, ','))
+			{
+				const auto parsed = ParseLevel(level);
+				if (!parsed)
+				{
+					std::cout << "Compression levels have to be comma separated numbers from 0 to 9." << std::endl << options.help() << std::endl;
+					return EXIT_FAILURE;
+				}
+				benchOptions.compressionLevels.push_back(*parsed);
+			}
+		}
+		benchOptions.threads = threads;
+		if (options.count("cache"))
+			benchOptions.cacheDirectory = options["cache"].as<std::string>();
+		benchOptions.memoryBudget = options.count("memory-budget") ? options["memory-budget"].as<uint64_t>() << 20 : 0;
+
+		return Bench(benchOptions) ? 0 : EXIT_FAILURE;
+	}
+
+	if (pack)
+	{
+		PackOptions packOptions;
+		packOptions.directory = directory;
+		packOptions.file = file;
+		const auto format = options.count("format") ? options["format"].as<std::string>() : "bnd2";
+		if (format == "bnd2")
+			packOptions.magicVersion = Bundle::BND2;
+		else if (format == "bndl")
+			packOptions.magicVersion = Bundle::BNDL;
+		else
+		{
+			std::cout << "Unknown format " << format << std::endl << options.help() << std::endl;
+			return EXIT_FAILURE;
+		}
+		const auto platform = options.count("platform") ? options["platform"].as<std::string>() : "pc";
+		if (platform == "pc")
+			packOptions.platform = Bundle::PC;
+		else if (platform == "xbox360")
+			packOptions.platform = Bundle::Xbox360;
+		else if (platform == "ps3")
+			packOptions.platform = Bundle::PS3;
+		else
+		{
+			std::cout << "Unknown platform " << platform << std::endl << options.help() << std::endl;
+			return EXIT_FAILURE;
+		}
+		// BNDL only ever shipped on Xbox 360.
+		if (packOptions.magicVersion == Bundle::BNDL)
+			packOptions.platform = Bundle::Xbox360;
+		packOptions.compressed = !options["uncompressed"].as<bool>();
+		packOptions.resourceType = Bundle::RawFile;
+		if (options.count("resource-type"))
+		{
+			const auto resourceType = layout::ParseHex(options["resource-type"].as<std::string>());
+			if (!resourceType)
+			{
+				std::cout << "The resource type has to be a hex number." << std::endl << options.help() << std::endl;
+				return EXIT_FAILURE;
+			}
+			packOptions.resourceType = static_cast<Bundle::ResourceType>(*resourceType);
+		}
+		const auto level = ParseLevel(options.count("level") ? options["level"].as<std::string>() : "9");
+		if (!level)
+		{
+			std::cout << "The compression level has to be a number from 0 to 9." << std::endl << options.help() << std::endl;
+			return EXIT_FAILURE;
+		}
+		packOptions.compressionLevel = *level;
+		packOptions.deduplicate = options["dedup"].as<bool>();
+		if (options.count("layout"))
+			packOptions.layout = options["layout"].as<std::string>();
+		packOptions.threads = threads;
+
+		if (!Pack(packOptions))
+			return EXIT_FAILURE;
+	}
+
 	Bundle arch;
 	if (!pack)
 	{
@@ -45,25 +223,57 @@ int main(int argc, char** argv)
 			return EXIT_FAILURE;
 		}
 
+		if (extract)
+		{
+			ExtractOptions extractOptions;
+			extractOptions.directory = directory;
+			const auto resourceTypes = options.count("type") ? ParseHexList(options["type"].as<std::string>()) : std::vector<uint32_t>();
+			const auto resourceIDs = options.count("id") ? ParseHexList(options["id"].as<std::string>()) : std::vector<uint32_t>();
+			if (!resourceTypes || !resourceIDs)
+			{
+				std::cout << "Resource types and IDs have to be comma separated hex numbers." << std::endl << options.help() << std::endl;
+				return EXIT_FAILURE;
+			}
+			extractOptions.resourceTypes = *resourceTypes;
+			extractOptions.resourceIDs = *resourceIDs;
+			if (options.count("name"))
+				extractOptions.name = options["name"].as<std::string>();
+			extractOptions.threads = threads;
+
+			if (options.count("record-access"))
+				arch.EnableAccessRecording(true);
+			if (options.count("cache"))
+				arch.SetCacheDirectory(options["cache"].as<std::string>());
+			if (options.count("memory-budget"))
+				arch.SetMemoryBudget(options["memory-budget"].as<uint64_t>() << 20);
+
+			if (!Extract(arch, extractOptions))
+				return EXIT_FAILURE;
+
+			if (options.count("record-access") && !arch.SaveAccessTrace(options["record-access"].as<std::string>()))
+			{
+				std::cout << "Failed to write the access trace" << std::endl;
+				return EXIT_FAILURE;
+			}
+		}
+
 		if (list)
 		{
 			std::cout.fill('-');
 			std::cout << std::left << std::setw(70) << "NAME" << std::right << "FILE TYPE" << std::endl;
 			std::cout.fill(' ');
-			for (const auto &resourceID : arch.ListResourceIDs())
+			for (const auto &entry : arch.Entries())
 			{
-				const auto debugInfo = arch.GetDebugInfo(resourceID);
-				const auto resourceType = *arch.GetResourceType(resourceID);
 				std::ostringstream name;
-				if (debugInfo)
-					name << debugInfo->name;
+				if (entry.debugInfo)
+					name << entry.debugInfo->name;
 				else
-					name << std::hex << resourceID;
+					name << std::hex << entry.resourceID;
 				std::ostringstream typeName;
-				if (debugInfo)
-					typeName << debugInfo->typeName;
+				if (entry.debugInfo)
+					typeName << entry.debugInfo->typeName;
 				else
-					typeName << std::hex << resourceType;
+					typeName << std::hex << entry.resourceType;
 				std::cout << std::left << std::setw(70) << name.str() << std::right << typeName.str() << std::endl;
 			}
 		}
@@ -0,0 +1,336 @@
+#include "pack.hpp"
+#include "layout.hpp"
+#include "threadpool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace libbndl;
+
+namespace
+{
+	struct PackJob
+	{
+		std::filesystem::path path; // A resource directory, or a single file for plain trees.
+		std::string name; // Hashed into the ID for plain trees.
+		uint32_t resourceID = 0;
+		Bundle::ResourceType resourceType;
+		std::optional<Bundle::EntryDebugInfo> debugInfo;
+
+		// Filled in by the workers.
+		std::optional<Bundle::EntryData> data;
+		std::optional<Bundle::CompressedEntryData> compressed;
+	};
+
+	bool ReadBundleInfo(const std::filesystem::path &path, Bundle &bundle, const PackOptions &options)
+	{
+		std::ifstream file(path);
+		if (file.fail())
+			return false;
+
+		auto magicVersion = Bundle::BND2;
+		uint32_t revisionNumber = 2, platform = Bundle::PC, flags = 0;
+		std::string key;
+		while (file >> key)
+		{
+			if (key == "magic")
+			{
+				std::string magic;
+				file >> magic;
+				magicVersion = magic == "bndl" ? Bundle::BNDL : Bundle::BND2;
+			}
+			else if (key == "revision")
+				file >> revisionNumber;
+			else if (key == "platform")
+				file >> std::hex >> platform >> std::dec;
+			else if (key == "flags")
+				file >> std::hex >> flags >> std::dec;
+		}
+
+		bundle = Bundle(magicVersion, revisionNumber, static_cast<Bundle::Platform>(platform), static_cast<Bundle::Flags>(flags));
+		bundle.SetCompressionLevel(options.compressionLevel);
+
+		return true;
+	}
+
+	bool ReadResourceInfo(PackJob &job, Bundle::EntryData &data)
+	{
+		std::ifstream file(job.path / layout::ResourceInfoFile);
+		if (file.fail())
+			return false;
+
+		std::string line;
+		while (std::getline(file, line))
+		{
+			std::istringstream stream(line);
+			std::string key;
+			stream >> key;
+			stream.get();
+
+			if (key == "alignment")
+			{
+				uint32_t fileBlock;
+				stream >> fileBlock;
+				if (fileBlock < 3)
+					stream >> data.alignments[fileBlock];
+			}
+			else if (key == "dependency")
+			{
+				Bundle::Dependency dependency;
+				stream >> std::hex >> dependency.resourceID >> dependency.internalOffset;
+				data.dependencies.push_back(dependency);
+			}
+			else if (key == "name")
+			{
+				job.debugInfo = job.debugInfo.value_or(Bundle::EntryDebugInfo());
+				std::getline(stream, job.debugInfo->name);
+			}
+			else if (key == "typename")
+			{
+				job.debugInfo = job.debugInfo.value_or(Bundle::EntryDebugInfo());
+				std::getline(stream, job.debugInfo->typeName);
+			}
+		}
+
+		return true;
+	}
+
+	bool ReadResource(PackJob &job, bool extracted, Bundle::MagicVersion magicVersion)
+	{
+		Bundle::EntryData data;
+		// Same defaults as the game's own tools use, if there is nothing better to go on.
+		data.alignments[0] = 16;
+		data.alignments[1] = magicVersion == Bundle::BND2 ? 128 : 16;
+		data.alignments[2] = 16;
+
+		if (!extracted)
+		{
+			data.fileBlockData[0] = layout::ReadFile(job.path);
+			if (data.fileBlockData[0] == nullptr)
+				return false;
+		}
+		else
+		{
+			if (!ReadResourceInfo(job, data))
+				return false;
+
+			for (auto i = 0U; i < 3; i++)
+			{
+				const auto blockFile = layout::BlockFile(job.path, i);
+				if (std::filesystem::exists(blockFile) && (data.fileBlockData[i] = layout::ReadFile(blockFile)) == nullptr)
+					return false;
+			}
+		}
+
+		job.data = std::move(data);
+		return true;
+	}
+
+	// Resource directories of an extracted bundle, or every file of a plain tree, sorted by ID.
+	// Says why and gives nothing if any of it can't be read or isn't named as extract names it.
+	std::optional<std::vector<PackJob>> FindResources(const std::filesystem::path &root, bool extracted, Bundle::ResourceType resourceType)
+	{
+		std::vector<PackJob> jobs;
+		std::error_code error;
+
+		const auto failed = [&error](const std::filesystem::path &path)
+		{
+			std::cout << "Failed to read " << path.string() << ": " << error.message() << std::endl;
+		};
+
+		if (!extracted)
+		{
+			auto it = std::filesystem::recursive_directory_iterator(root, error);
+			for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+			{
+				if (!it->is_regular_file(error))
+				{
+					if (error)
+						break;
+					continue;
+				}
+
+				PackJob job;
+				job.path = it->path();
+				job.name = it->path().lexically_relative(root).generic_string();
+				job.resourceID = Bundle::HashResourceName(job.name);
+				job.resourceType = resourceType;
+				job.debugInfo = Bundle::EntryDebugInfo{ job.name, "" };
+				jobs.push_back(std::move(job));
+			}
+			if (error)
+			{
+				failed(root);
+				return {};
+			}
+		}
+		else
+		{
+			auto typeIt = std::filesystem::directory_iterator(root, error);
+			for (; !error && typeIt != std::filesystem::directory_iterator(); typeIt.increment(error))
+			{
+				if (!typeIt->is_directory(error))
+				{
+					if (error)
+						break;
+					continue;
+				}
+
+				const auto type = layout::ParseHex(typeIt->path().filename().string());
+				if (!type)
+				{
+					std::cout << typeIt->path().string() << " isn't named after a resource type in hex" << std::endl;
+					return {};
+				}
+
+				auto resourceIt = std::filesystem::directory_iterator(typeIt->path(), error);
+				for (; !error && resourceIt != std::filesystem::directory_iterator(); resourceIt.increment(error))
+				{
+					if (!resourceIt->is_directory(error))
+					{
+						if (error)
+							break;
+						continue;
+					}
+
+					const auto resourceID = layout::ParseHex(resourceIt->path().filename().string());
+					if (!resourceID)
+					{
+						std::cout << resourceIt->path().string() << " isn't named after a resource ID in hex" << std::endl;
+						return {};
+					}
+
+					PackJob job;
+					job.path = resourceIt->path();
+					job.resourceID = *resourceID;
+					job.resourceType = static_cast<Bundle::ResourceType>(*type);
+					jobs.push_back(std::move(job));
+				}
+				if (error)
+				{
+					failed(typeIt->path());
+					return {};
+				}
+			}
+			if (error)
+			{
+				failed(root);
+				return {};
+			}
+		}
+
+		// Adding in ID order appends every entry instead of shifting the ones after it.
+		std::sort(jobs.begin(), jobs.end(), [](const PackJob &a, const PackJob &b)
+		{
+			return a.resourceID < b.resourceID;
+		});
+
+		return jobs;
+	}
+}
+
+bool Pack(const PackOptions &options)
+{
+	const auto extracted = std::filesystem::exists(options.directory / layout::BundleInfoFile);
+
+	Bundle bundle;
+	if (extracted)
+	{
+		if (!ReadBundleInfo(options.directory / layout::BundleInfoFile, bundle, options))
+			return false;
+	}
+	else
+	{
+		auto flags = Bundle::UnusedFlag1 | Bundle::UnusedFlag2 | Bundle::HasResourceStringTable;
+		if (options.compressed)
+			flags |= Bundle::Compressed;
+		bundle = Bundle(options.magicVersion, options.magicVersion == Bundle::BND2 ? 2 : 5, options.platform, static_cast<Bundle::Flags>(flags));
+		bundle.SetCompressionLevel(options.compressionLevel);
+	}
+
+	auto found = FindResources(options.directory, extracted, options.resourceType);
+	if (!found)
+		return false;
+	auto &jobs = *found;
+	const auto compressed = (bundle.GetFlags() & Bundle::Compressed) != 0;
+	const auto magicVersion = bundle.GetMagicVersion();
+
+	// Reading and deflating only needs the bundle's settings, so all of it happens on the workers.
+	std::atomic<size_t> readFailures = 0;
+	std::atomic<size_t> compressFailures = 0;
+	{
+		ThreadPool pool(options.threads);
+		for (auto &job : jobs)
+		{
+			pool.Submit([&bundle, &job, &readFailures, &compressFailures, extracted, compressed, magicVersion]
+			{
+				if (!ReadResource(job, extracted, magicVersion))
+				{
+					readFailures++;
+					return;
+				}
+
+				if (compressed)
+				{
+					job.compressed = bundle.CompressResource(*job.data);
+					job.data.reset();
+					if (!job.compressed)
+						compressFailures++;
+				}
+			});
+		}
+		pool.Wait();
+	}
+
+	if (readFailures > 0)
+		std::cout << "Failed to read " << readFailures << " resources from " << options.directory.string() << std::endl;
+	if (compressFailures > 0)
+		std::cout << "Failed to compress " << compressFailures << " resources" << std::endl;
+	if (readFailures > 0 || compressFailures > 0)
+		return false;
+
+	for (auto &job : jobs)
+	{
+		const auto added = job.compressed
+			? bundle.AddCompressedResource(job.resourceID, std::move(*job.compressed), job.resourceType)
+			: bundle.AddResource(job.resourceID, std::move(*job.data), job.resourceType);
+		if (added && job.debugInfo)
+			bundle.AddDebugInfo(job.resourceID, job.debugInfo->name, job.debugInfo->typeName);
+		if (!added)
+		{
+			std::cout << "Failed to add " << job.path.string() << std::endl;
+			return false;
+		}
+	}
+
+	Bundle::SaveOptions saveOptions;
+	saveOptions.deduplicate = options.deduplicate;
+	if (options.layout == "dependencies")
+	{
+		saveOptions.layoutOrder = bundle.GetDependencyOrder(bundle.ListResourceIDs());
+	}
+	else if (!options.layout.empty())
+	{
+		auto order = Bundle::LoadAccessTrace(options.layout);
+		if (!order)
+		{
+			std::cout << "Failed to read the access trace " << options.layout << std::endl;
+			return false;
+		}
+		saveOptions.layoutOrder = std::move(*order);
+	}
+	Bundle::SaveReport report;
+	if (!bundle.Save(options.file, saveOptions, &report))
+	{
+		std::cout << "Failed to write " << options.file << std::endl;
+		return false;
+	}
+
+	std::cout << "Packed " << jobs.size() << " resources into " << options.file << std::endl;
+	if (options.deduplicate)
+		std::cout << "Deduplicated " << report.duplicateBlocks << " blocks, saving " << report.bytesSaved << " bytes" << std::endl;
+
+	return true;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <libbndl/bundle.hpp>
+#include <filesystem>
+#include <string>
+
+struct PackOptions
+{
+	std::filesystem::path directory;
+	std::string file;
+	// Used when the directory isn't an extracted bundle; otherwise bundle.txt decides.
+	libbndl::Bundle::MagicVersion magicVersion;
+	libbndl::Bundle::Platform platform;
+	bool compressed;
+	libbndl::Bundle::ResourceType resourceType; // For every file of a plain directory tree.
+	int compressionLevel;
+	bool deduplicate; // Store identical blocks once.
+	std::string layout; // Access trace file or "dependencies"; empty keeps ID order.
+	unsigned threads;
+};
+
+bool Pack(const PackOptions &options);
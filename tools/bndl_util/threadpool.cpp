@@ -0,0 +1,65 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+	threadCount = std::max(threadCount, 1U);
+	for (auto i = 0U; i < threadCount; i++)
+		m_threads.emplace_back(&ThreadPool::Work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_jobAvailable.notify_all();
+
+	for (auto &thread : m_threads)
+		thread.join();
+}
+
+void ThreadPool::Submit(std::function<void()> job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_jobs.push(std::move(job));
+		m_unfinished++;
+	}
+	m_jobAvailable.notify_one();
+}
+
+void ThreadPool::Wait()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idle.wait(lock, [this] { return m_unfinished == 0; });
+}
+
+unsigned ThreadPool::DefaultThreadCount()
+{
+	return std::max(std::thread::hardware_concurrency(), 1U);
+}
+
+void ThreadPool::Work()
+{
+	while (true)
+	{
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+			if (m_jobs.empty())
+				return;
+
+			job = std::move(m_jobs.front());
+			m_jobs.pop();
+		}
+
+		job();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_unfinished == 0)
+			m_idle.notify_all();
+	}
+}
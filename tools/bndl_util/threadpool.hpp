@@ -0,0 +1,33 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Runs submitted jobs on a fixed set of threads.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(unsigned threadCount);
+	~ThreadPool();
+
+	void Submit(std::function<void()> job);
+	// Blocks until every job submitted so far has finished.
+	void Wait();
+
+	// The hardware thread count, or 1 if that is unknown.
+	static unsigned DefaultThreadCount();
+
+private:
+	void Work();
+
+	std::vector<std::thread> m_threads;
+	std::queue<std::function<void()>> m_jobs;
+	std::mutex m_mutex;
+	std::condition_variable m_jobAvailable;
+	std::condition_variable m_idle;
+	size_t m_unfinished = 0;
+	bool m_stopping = false;
+};